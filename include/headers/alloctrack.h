@@ -0,0 +1,60 @@
+#ifndef ALLOCTRACK_H
+#define ALLOCTRACK_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+
+// Allocation tracking, compiled in with -DTRACK_ALLOCATIONS (global operator new/delete are then replaced)
+
+// Subsystem charged for the allocations made by the calling thread
+enum AllocTag : uint8_t {
+    ALLOC_UNTAGGED,    // anything outside of a frame stage (loading, joins, ...)
+    ALLOC_SIMULATION,  // simulate(), step(), actions
+    ALLOC_RENDER,      // render()
+    ALLOC_OBSERVATION, // Observation::process()
+    ALLOC_NETWORK,     // rollback sessions and server state packets
+    ALLOC_TAGS
+};
+
+struct AllocCounters {
+    uint64_t count = 0; // number of allocations
+    uint64_t bytes = 0; // bytes requested
+};
+
+struct AllocStats {
+    AllocCounters tags[ALLOC_TAGS];
+    int64_t live_bytes = 0; // bytes allocated and not freed yet
+
+    AllocCounters total() const;
+};
+
+bool alloc_tracking();       // true when built with TRACK_ALLOCATIONS
+AllocStats alloc_stats();    // counters since the start of the process
+AllocStats alloc_frame();    // counters of the last frame closed by alloc_frame_end()
+void alloc_frame_end();      // close the current frame, called once per frame by the main loop
+AllocTag alloc_tag();        // tag of the calling thread, handed over to the jobs it queues on a ThreadPool
+void alloc_strict(const uint64_t warmup); // abort on any tagged allocation after warmup frames (also set by DOOM_ALLOC_STRICT=<frames>)
+void alloc_report(FILE *out, const AllocStats &stats); // one line per tag with allocations, without allocating
+
+#ifdef TRACK_ALLOCATIONS
+// Charges the allocations of the calling thread to tag until the end of the scope
+class AllocScope {
+public:
+    explicit AllocScope(const AllocTag tag);
+    ~AllocScope();
+
+    AllocScope(const AllocScope&) = delete;
+    AllocScope& operator=(const AllocScope&) = delete;
+
+private:
+    AllocTag previous;
+};
+#else
+class AllocScope {
+public:
+    explicit AllocScope(const AllocTag) {}
+};
+#endif
+
+#endif // ALLOCTRACK_H
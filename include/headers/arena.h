@@ -0,0 +1,63 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <type_traits>
+
+// Bump allocator for the temporaries of one frame: everything is released at once by reset() or rewind()
+class FrameArena {
+public:
+    explicit FrameArena(const size_t capacity = 64 * 1024);
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // n uninitialized objects, valid until the next reset() or rewind()
+    template<typename T> T *alloc(const size_t n) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        return static_cast<T*>(alloc_bytes(n * sizeof(T), alignof(T)));
+    }
+
+    // n copies of value, valid until the next reset() or rewind()
+    template<typename T> T *alloc(const size_t n, const T &value) {
+        T *p = alloc<T>(n);
+        for (size_t i=0; i<n; i++) new (p + i) T(value);
+        return p;
+    }
+
+    void reset();            // release everything, growing the arena to the peak usage seen so far
+    size_t mark() const;     // position to rewind() to, releasing what is allocated afterwards
+    void rewind(size_t mark); // release everything allocated since mark(), a mark of 0 is a reset()
+    size_t used() const;     // bytes handed out since the last reset()
+    size_t capacity() const; // bytes available without allocating from the heap
+
+    static FrameArena &local(); // arena of the calling thread
+
+private:
+    std::unique_ptr<unsigned char[]> block;                  // main storage
+    size_t block_size;
+    size_t offset;                                           // first free byte of block
+    std::vector<std::unique_ptr<unsigned char[]>> overflow;  // storage allocated when block was full
+    size_t overflow_bytes;
+
+    void *alloc_bytes(const size_t bytes, const size_t align);
+};
+
+// Releases at the end of the scope what was allocated from the arena during the scope, so that scopes can nest
+class ArenaScope {
+public:
+    explicit ArenaScope(FrameArena &arena) : arena(arena), start(arena.mark()) {}
+    ~ArenaScope() { arena.rewind(start); }
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    FrameArena &arena;
+    const size_t start;
+};
+
+#endif // ARENA_H
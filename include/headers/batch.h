@@ -0,0 +1,49 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <vector>
+#include <cstdint>
+
+#include "tinyraycaster.h"
+#include "threadpool.h"
+#include "observation.h"
+
+// N independent game instances stepped and rendered together, e.g. as a training environment for agents
+class BatchEnv {
+public:
+    size_t frame_w, frame_h; // size of one observation in pixels
+
+    BatchEnv(const GameState &initial, const size_t count, const size_t frame_w, const size_t frame_h, const size_t threads = 0);
+
+    size_t size() const;                  // number of game instances
+    size_t frame_size() const;            // number of pixels of one observation
+    GameState &env(const size_t i);
+    const GameState &env(const size_t i) const;
+
+    void reset(const size_t i);           // put the instance i back in the initial state
+    void reset_all();
+
+    // apply actions[i] to the instance i and advance all the instances by repeat ticks, without rendering
+    void step(const std::vector<Action> &actions, const size_t repeat = 1);
+
+    // render all the instances into out, which must hold size()*frame_size() pixels; observation i starts at out + i*frame_size()
+    void render(uint32_t *out);
+
+    // enable the observation stage, applied by observe() to every instance
+    void set_observation(const ObsConfig &config);
+    size_t observation_bytes() const;  // size of one stacked observation
+
+    // render all the instances and write their observations into out, which must hold size()*observation_bytes() bytes
+    void observe(uint8_t *out);
+
+private:
+    GameState initial;           // state used by reset(), shares its textures with every instance
+    std::vector<GameState> envs;
+    std::vector<Observation> observations; // one frame stack per instance, empty until set_observation()
+    std::unique_ptr<ThreadPool> own_pool; // only when a number of threads is given
+    ThreadPool &pool;                     // own_pool or ThreadPool::shared()
+
+    FrameBuffer &render_instance(const size_t i);
+};
+
+#endif // BATCH_H
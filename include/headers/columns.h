@@ -0,0 +1,168 @@
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+#include "framebuffer.h"
+
+// Column kernels: draw a vertical span of texels into a FrameBuffer, specialized at compile time on
+// the texel format, the blending and the shading, so that the inner loop has no branch or division
+
+// How the texels are combined with the framebuffer
+enum class Blend {
+    OPAQUE,     // every texel is written (walls)
+    ALPHA_MASK, // texels with alpha <= 128 are skipped (sprites)
+    COLOR_KEY   // texels equal to the key color are skipped (gun)
+};
+
+// Transform applied to the texel colors before they are written
+enum class Shade {
+    NONE,
+    HALF, // every component halved, alpha cleared (as the floor and the ceiling)
+    FOG   // blended with the fog color, see FogBlend
+};
+
+// Fog color blended over the texels by Shade::FOG, weight/256 of it
+struct FogBlend {
+    uint32_t color;
+    uint32_t weight; // 0 (no fog) to 256 (only fog)
+};
+
+// Blends the color components (not the alpha) with the fog, two components at a time
+inline uint32_t blend_fog(const uint32_t color, const FogBlend &fog) {
+    const uint32_t w = fog.weight, k = 256 - w;
+    const uint32_t rb = (((color & 0xFF00FF) * k + (fog.color & 0xFF00FF) * w) >> 8) & 0xFF00FF;
+    const uint32_t g = (((color & 0x00FF00) * k + (fog.color & 0x00FF00) * w) >> 8) & 0x00FF00;
+    return (color & 0xFF000000) | rb | g;
+}
+
+// 32 bit texels, as loaded by Texture
+struct RGBA32 {
+    using texel = uint32_t;
+    static uint32_t color(const texel t, const uint32_t *) { return t; }
+};
+
+// 8 bit palette indices
+struct Indexed8 {
+    using texel = uint8_t;
+    static uint32_t color(const texel t, const uint32_t *palette) { return palette[t]; }
+};
+
+// Exact integer stepping of a texture coordinate: the i-th value is (start + i*step) / den, rounded
+// down, computed with a running quotient and remainder instead of a division per pixel
+struct TexStepper {
+    uint64_t q, r;   // current coordinate and remainder
+    uint64_t dq, dr; // quotient and remainder of the step
+    uint64_t den;
+
+    TexStepper(const uint64_t start, const uint64_t step, const uint64_t den) : q(start / den), r(start % den), dq(step / den), dr(step % den), den(den) {
+        assert(den > 0);
+    }
+
+    void advance() {
+        q += dq;
+        r += dr;
+        if (r >= den) { r -= den; q++; }
+    }
+};
+
+/**
+ * @brief Draws the rows [y0, y1) of the column x with the texels src[v*stride], v stepping once per row.
+ * 
+ * @tparam Format The texel format (RGBA32 or Indexed8).
+ * @tparam B The blending of the texels with the framebuffer.
+ * @tparam S The shading of the texel colors.
+ * @tparam Aux Whether the depth and label buffers of the framebuffer are written along with the pixels.
+ * @param fb The framebuffer to draw into.
+ * @param x The column.
+ * @param y0 The first row.
+ * @param y1 The row after the last one.
+ * @param src The texel of the texture column at coordinate 0.
+ * @param stride The distance between two texels of the texture column.
+ * @param v The texture coordinate of the row y0 and its step.
+ * @param z The depth written in the depth buffer.
+ * @param label The semantic label written in the label buffer.
+ * @param key The skipped color, for Blend::COLOR_KEY.
+ * @param palette The colors of the indices, for Indexed8.
+ * @param fog The fog blended over the texels, for Shade::FOG.
+ */
+template <typename Format, Blend B, Shade S, bool Aux>
+inline void draw_column_span(FrameBuffer &fb, const size_t x, const size_t y0, const size_t y1, const typename Format::texel *src, const size_t stride,
+                             TexStepper v, const float z, const uint16_t label, const uint32_t key = 0, const uint32_t *palette = nullptr, const FogBlend &fog = FogBlend{ 0, 0 }) {
+    assert(fb.img.size() == fb.w*fb.h && x < fb.w && y0 <= y1 && y1 <= fb.h);
+    uint32_t *dst = fb.img.data() + x;
+    float *depth = Aux && !fb.depth.empty() ? fb.depth.data() + x : nullptr;
+    uint16_t *labels = Aux && !fb.labels.empty() ? fb.labels.data() + x : nullptr;
+
+    for (size_t y = y0, offset = y0*fb.w; y < y1; y++, offset += fb.w, v.advance()) {
+        uint32_t color = Format::color(src[v.q * stride], palette);
+        if (B == Blend::ALPHA_MASK && (color >> 24) <= 128) continue;
+        if (B == Blend::COLOR_KEY && color == key) continue;
+        if (S == Shade::HALF) color = (color >> 1) & 8355711;
+        if (S == Shade::FOG) color = blend_fog(color, fog);
+        dst[offset] = color;
+        if (Aux) {
+            if (depth) depth[offset] = z;
+            if (labels) labels[offset] = label;
+        }
+    }
+}
+
+// Same, choosing the kernel that writes the depth and label buffers at run time
+template <typename Format, Blend B, Shade S>
+inline void draw_column(const bool aux, FrameBuffer &fb, const size_t x, const size_t y0, const size_t y1, const typename Format::texel *src, const size_t stride,
+                        const TexStepper &v, const float z, const uint16_t label, const uint32_t key = 0, const uint32_t *palette = nullptr, const FogBlend &fog = FogBlend{ 0, 0 }) {
+    if (aux) draw_column_span<Format, B, S, true>(fb, x, y0, y1, src, stride, v, z, label, key, palette, fog);
+    else     draw_column_span<Format, B, S, false>(fb, x, y0, y1, src, stride, v, z, label, key, palette, fog);
+}
+
+/**
+ * @brief Draws the rows [y0, y1) of the column x not covered yet, front to back: as draw_column_span,
+ * but the rows whose covered flag is set are skipped and the flag of the rows drawn is set.
+ * 
+ * Drawing the closest spans first with this kernel gives the pixels of drawing all of them from
+ * the farthest with draw_column_span, while every pixel is written at most once.
+ * 
+ * @param covered A flag for every row of the framebuffer.
+ * @return The number of rows drawn, now covered.
+ */
+template <typename Format, Blend B, Shade S, bool Aux>
+inline size_t draw_column_span_under(FrameBuffer &fb, const size_t x, const size_t y0, const size_t y1, const typename Format::texel *src, const size_t stride,
+                                     TexStepper v, const float z, const uint16_t label, uint8_t *covered, const uint32_t key = 0, const uint32_t *palette = nullptr,
+                                     const FogBlend &fog = FogBlend{ 0, 0 }) {
+    assert(fb.img.size() == fb.w*fb.h && x < fb.w && y0 <= y1 && y1 <= fb.h);
+    uint32_t *dst = fb.img.data() + x;
+    float *depth = Aux && !fb.depth.empty() ? fb.depth.data() + x : nullptr;
+    uint16_t *labels = Aux && !fb.labels.empty() ? fb.labels.data() + x : nullptr;
+
+    size_t drawn = 0;
+    for (size_t y = y0, offset = y0*fb.w; y < y1; y++, offset += fb.w, v.advance()) {
+        if (covered[y]) continue;
+        uint32_t color = Format::color(src[v.q * stride], palette);
+        if (B == Blend::ALPHA_MASK && (color >> 24) <= 128) continue;
+        if (B == Blend::COLOR_KEY && color == key) continue;
+        if (S == Shade::HALF) color = (color >> 1) & 8355711;
+        if (S == Shade::FOG) color = blend_fog(color, fog);
+        dst[offset] = color;
+        covered[y] = 1;
+        drawn++;
+        if (Aux) {
+            if (depth) depth[offset] = z;
+            if (labels) labels[offset] = label;
+        }
+    }
+    return drawn;
+}
+
+// Same, choosing the kernel that writes the depth and label buffers at run time
+template <typename Format, Blend B, Shade S>
+inline size_t draw_column_under(const bool aux, FrameBuffer &fb, const size_t x, const size_t y0, const size_t y1, const typename Format::texel *src, const size_t stride,
+                                const TexStepper &v, const float z, const uint16_t label, uint8_t *covered, const uint32_t key = 0, const uint32_t *palette = nullptr,
+                                const FogBlend &fog = FogBlend{ 0, 0 }) {
+    if (aux) return draw_column_span_under<Format, B, S, true>(fb, x, y0, y1, src, stride, v, z, label, covered, key, palette, fog);
+    else     return draw_column_span_under<Format, B, S, false>(fb, x, y0, y1, src, stride, v, z, label, covered, key, palette, fog);
+}
+
+#endif // COLUMNS_H
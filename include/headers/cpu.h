@@ -0,0 +1,31 @@
+#ifndef CPU_H
+#define CPU_H
+
+// Instruction sets the hot kernels are built for, from the slowest to the fastest
+enum class CpuLevel {
+    GENERIC, // portable C++ (SSE2 on x86-64)
+    SSE42,
+    AVX2,
+    AVX512
+};
+
+// The ISA variants are compiled with GCC/Clang target attributes on x86. MinGW does not align the
+// stack for 32 and 64 byte vectors, so only the SSE4.2 variant is built there
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_DISPATCH 1
+#if !defined(_WIN32)
+#define CPU_DISPATCH_AVX 1
+#endif
+#endif
+
+CpuLevel cpu_detect(); // best level supported by both the processor and this build
+
+// Level used by the kernels: cpu_detect(), unless lowered by the DOOM_CPU environment variable
+// (generic, sse4.2, avx2 or avx512) or by set_cpu_level()
+CpuLevel cpu_level();
+
+bool set_cpu_level(const CpuLevel level); // false (and no change) if the level is not supported
+bool parse_cpu_level(const char *name, CpuLevel &level);
+const char *cpu_level_name(const CpuLevel level);
+
+#endif // CPU_H
@@ -3,13 +3,40 @@
 
 #include <cstdint>
 #include <vector>
+#include <string>
+
+struct SDL_Renderer;
+
+// Where the ray of a screen column hit a wall, see FrameBuffer::ray_hits
+struct RayHit {
+    int32_t cell_x, cell_y; // map cell of the wall, or the last cell crossed when side is -1
+    int32_t side;           // 0 for a side of the cell crossed along x, 1 along y, -1 when the ray stopped at the draw distance
+    float hit_x, hit_y;     // point of the map where the ray hit the wall
+    float dist;             // distance from the player to the hit point, as in the depth buffer
+    float perp_dist;        // same, projected on the view direction
+    int32_t texture;        // wall texture (the map value of the cell), -1 for the fog
+    int32_t tex_x;          // column of the texture
+};
 
 struct FrameBuffer {
     size_t w, h; // image dimensions
     std::vector<uint32_t> img; // storage container
+    std::vector<float> depth{};     // optional per-pixel distance from the player, filled by render() once allocated with enable_aux()
+    std::vector<uint16_t> labels{}; // optional per-pixel semantic label (see SemanticLabel), filled by render() once allocated with enable_aux()
+    std::vector<uint64_t> visible_cells{}; // optional bitset of the map cells crossed by the rays of the 3D view (bit i + j*visible_w),
+                                           // filled by render() once allocated with enable_visible_cells()
+    size_t visible_w = 0, visible_h = 0;   // map dimensions of visible_cells
+    std::vector<RayHit> ray_hits{};        // optional wall hit of the ray of every column, filled by render() once allocated with enable_ray_hits()
     
     void clear(const uint32_t color);
     void set_pixel(const size_t x, const size_t y, const uint32_t color);
+    void enable_aux(const bool with_depth, const bool with_labels);
+    bool has_aux() const;
+    void set_aux(const size_t x, const size_t y, const float z, const uint16_t label);
+    void enable_visible_cells(const size_t map_w, const size_t map_h); // 0 x 0 to release the bitset
+    bool cell_visible(const size_t i, const size_t j) const;           // false outside of the map or when not enabled
+    size_t visible_cell_count() const;
+    void enable_ray_hits(const bool enabled);
     void draw_rectangle(const size_t x, const size_t y, const size_t w, const size_t h, const uint32_t color);
     void draw_text(SDL_Renderer* renderer, const std::string &text, const size_t x, const size_t y, const uint32_t color);
 };
@@ -0,0 +1,75 @@
+#ifndef FRAMEGRAPH_H
+#define FRAMEGRAPH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "tinyraycaster.h"
+
+class ThreadPool;
+
+// Resources of a frame read and written by the render passes, combined as bit masks
+enum RenderResource : uint32_t {
+    RES_FRAME   = 1, // pixels of the framebuffer, with its depth and label buffers
+    RES_DEPTH   = 2, // distance of the wall drawn in every column
+    RES_MINIMAP = 4  // layer the minimap is drawn into before being composited over the frame
+};
+
+// Everything the passes of one frame work on, its buffers are in the FrameArena of the thread calling render()
+struct RenderFrame {
+    FrameBuffer &fb;
+    const GameState &gs;
+    const RenderSettings &settings;
+    ThreadPool *pool;       // pool the passes may use for their own loops, nullptr for the calling thread only
+    float *depth_buffer;    // fb.w values
+    uint32_t *minimap;      // minimap_w * minimap_h pixels, drawn at (minimap_x, minimap_y) in the framebuffer
+    size_t minimap_x, minimap_y, minimap_w, minimap_h;
+    size_t cell_w, cell_h;  // size of one map cell on the screen
+};
+
+using RenderPass = void (*)(RenderFrame &frame);
+
+// Passes of a frame declaring the resources they use; passes without conflicts run concurrently
+class FrameGraph {
+public:
+    // append a pass, drawn after the ones already added when they touch the same resources;
+    // fills are the written resources the pass overwrites entirely, making earlier writers useless
+    void add(const std::string &name, const uint32_t reads, const uint32_t writes, const uint32_t fills, RenderPass run);
+
+    bool set_enabled(const std::string &name, const bool enabled); // false if there is no such pass
+    bool enabled(const std::string &name) const;
+    size_t size() const;
+
+    // run the enabled passes, on pool when given (the calling thread helps), in declaration order otherwise
+    void execute(RenderFrame &frame, ThreadPool *pool) const;
+
+    static constexpr size_t max_passes = 32;
+
+private:
+    struct Pass {
+        std::string name;
+        uint32_t reads, writes, fills;
+        RenderPass run;
+        bool enabled;
+    };
+    std::vector<Pass> passes;
+
+    struct Execution; // state of one execute() on a pool, shared by the jobs of its passes
+
+    uint32_t live_passes() const; // enabled passes whose writes are not entirely overwritten before being read
+    void run(const size_t index, RenderFrame &frame) const;
+    static void run_pass(void *data, size_t index, size_t);
+};
+
+// The passes drawn by render(): clear, view, minimap, sprites, minimap_composite and gun
+FrameGraph standard_frame_graph();
+
+// Same passes, but the 3D view and the sprites are drawn by a single pass cutting the screen into tiles
+FrameGraph tiled_frame_graph();
+
+// Render the game state with the given passes and settings, running them (and the 3D view loops) on pool if given
+void render(FrameBuffer &fb, const GameState &gs, const FrameGraph &graph, ThreadPool *pool = nullptr, const RenderSettings &settings = RenderSettings());
+
+#endif // FRAMEGRAPH_H
@@ -0,0 +1,30 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstdint>
+#include <cstddef>
+
+#include "cpu.h"
+
+// Rows of the floor and the ceiling: the row y = top + r of the screen shows the floor, the row h-1-y the ceiling
+struct FloorRows {
+    uint32_t *img;                    // framebuffer pixels
+    size_t w, h;                      // framebuffer size
+    size_t top;                       // first floor row, at least h/2
+    size_t x0, x1;                    // columns drawn, [x0, x1)
+    const uint32_t *floor, *ceiling;  // texel (0,0) of the floor and of the ceiling textures
+    size_t stride;                    // distance between two rows of the textures
+    float size;                       // texture size
+    int mask;                         // texture size - 1
+    const float *x, *y;               // for each r, the map position seen by the pixel x0 of the row
+    const float *step_x, *step_y;     // for each r, the step of the position from one pixel to the next
+};
+
+// Draws the first rows of [0, count) with the instruction set of the kernel (several rows at once,
+// one per vector lane) and returns how many it drew, leaving the remaining ones to the caller
+using FloorKernel = size_t (*)(const FloorRows &rows, const size_t count);
+
+// Kernel for the level, or nullptr for CpuLevel::GENERIC (the portable loop of the caller)
+FloorKernel floor_kernel(const CpuLevel level);
+
+#endif // KERNELS_H
@@ -2,12 +2,23 @@
 #define MAP_H
 
 #include <cstdlib>
+#include <cstdint>
 #include <utility>
+#include <memory>
+#include <string>
+#include <vector>
 
 struct Map {
+    static constexpr size_t chunk_size = 64; // number of cells in a copy-on-write chunk
+
+    struct Chunk {
+        char cells[chunk_size];
+    };
+
     size_t w, h; // overall map dimensions
 
     Map();
+    Map(const size_t w, const size_t h, const std::string &layout);
 
     int get(const size_t i, const size_t j) const;
     
@@ -16,6 +27,24 @@ struct Map {
     std::pair<int, int> check_door(const size_t i, const size_t j) const;
 
     void open_door(const size_t i, const size_t j);
+
+    // true if no wall or closed door lies on the segment between the two points
+    bool line_of_sight(const float x0, const float y0, const float x1, const float y1) const;
+
+    void reset();                   // drop every modification and go back to the base layout
+    size_t private_chunks() const;  // number of chunks copied from the base layout by this map
+
+    // append the cells that differ from the base layout to out, as (cell index, value) pairs
+    void modified_cells(std::vector<std::pair<uint32_t, char>> &out) const;
+    // go back to the base layout, then apply the given (cell index, value) pairs
+    void restore(const std::pair<uint32_t, char> *cells, const size_t count);
+
+private:
+    std::shared_ptr<const std::vector<std::shared_ptr<Chunk>>> base; // pristine layout, shared by all the maps built from it
+    std::vector<std::shared_ptr<Chunk>> chunks;                      // cells of this map, pointing to the base chunks until modified
+
+    char cell(const size_t i, const size_t j) const;
+    void set(const size_t i, const size_t j, const char c);
 };
 
-#endif // MAP_H
\ No newline at end of file
+#endif // MAP_H
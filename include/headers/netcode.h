@@ -0,0 +1,87 @@
+#ifndef NETCODE_H
+#define NETCODE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "tinyraycaster.h"
+#include "snapshot.h"
+#include "transport.h"
+
+// State of a multiplayer game, identical on every peer once they have simulated the same inputs
+struct NetState {
+    GameState world;             // map and monsters; world.player is not simulated
+    std::vector<Player> players; // every player of the session, indexed by peer
+};
+
+// Advance a multiplayer game by one tick: inputs[i] drives players[i], each monster chases the closest player
+void simulate(NetState &state, const Action *inputs);
+
+// Indices of the players and of the monsters that the player viewer can see (line of sight within the sprite draw distance)
+void visible_entities(const NetState &state, const size_t viewer, std::vector<uint32_t> &players, std::vector<uint32_t> &monsters);
+
+struct RollbackConfig {
+    size_t window = 64;        // ticks kept for rollback; the session stalls if a peer falls this far behind
+    size_t input_delay = 2;    // local inputs are scheduled this many ticks ahead, to hide part of the latency
+    size_t sync_interval = 60; // ticks between two consistency reports sent to each peer
+};
+
+// Peer-to-peer session exchanging only inputs: remote inputs are predicted, and mispredictions roll the game back and re-simulate it
+class RollbackSession {
+public:
+    RollbackSession(const GameState &initial, const size_t players, const size_t local, Transport &transport, const RollbackConfig &config = RollbackConfig());
+
+    // read the network, then simulate the next tick with the local input; returns false (without simulating) while waiting for late peers
+    bool advance(const Action &input);
+
+    void poll(); // read the network and roll back if a prediction was wrong, called by advance()
+
+    const NetState &state() const;
+    const GameState &view(); // the world seen by the local player, ready for render()
+    void save_confirmed(Snapshot &out); // state at the start of confirmed_tick(), the same on every peer of a consistent session
+
+    uint32_t tick() const;            // next tick to simulate
+    uint32_t confirmed_tick() const;  // first tick whose inputs are not all known
+    size_t rollbacks() const;         // number of rollbacks
+    size_t resimulated_ticks() const; // number of ticks simulated again because of rollbacks
+    size_t desyncs() const;           // entities found in a different state than reported by a peer
+
+private:
+    struct Report { // consistency report received from a peer: visible entities at the start of a tick
+        uint32_t tick;
+        std::vector<uint8_t> data;
+    };
+
+    RollbackConfig cfg;
+    size_t local;
+    Transport &transport;
+    NetState current;
+    NetState scratch;                  // state restored to check the reports
+    GameState view_state;
+    std::vector<Snapshot> snapshots;   // state at the start of tick t, in slot t % window
+    std::vector<uint8_t> inputs;       // input of player p at tick t, in slot (t % window) * players + p
+    std::vector<uint8_t> known;        // 1 if the input of the slot was received, 0 if it is a prediction
+    std::vector<uint8_t> last_input;   // last received input of each player, used as prediction
+    std::vector<uint32_t> received;    // for each peer, first tick whose input has not been received yet
+    std::vector<uint32_t> acked;       // for each peer, first local input tick it has not acknowledged
+    std::vector<Report> reports;
+    uint32_t now, confirmed, rollback_from;
+    size_t rollback_count, resimulated, desync_count;
+    std::vector<uint8_t> packet;
+    std::vector<uint32_t> seen_players, seen_monsters;
+    std::vector<Action> tick_inputs;
+
+    size_t players() const;
+    uint8_t &input_slot(const uint32_t t, const size_t p);
+    uint8_t &known_slot(const uint32_t t, const size_t p);
+    void set_input(const uint32_t t, const size_t p, const uint8_t input);
+    void simulate_tick(const uint32_t t);
+    void rollback();
+    void advance_confirmed();
+    void send_inputs();
+    void send_report(const uint32_t t);
+    void check_reports();
+    void handle_packet(const size_t peer);
+};
+
+#endif // NETCODE_H
@@ -0,0 +1,47 @@
+#ifndef OBSERVATION_H
+#define OBSERVATION_H
+
+#include <cstdint>
+#include <vector>
+
+#include "framebuffer.h"
+
+enum class ObsFormat {
+    RGBA,    // 4 bytes per pixel, same layout as the framebuffer
+    GRAY,    // 1 byte per pixel, luma
+    PALETTE  // 1 byte per pixel, index in the RGB332 palette
+};
+
+struct ObsConfig {
+    size_t w, h;      // observation dimensions, the framebuffer is box-filtered down to them (or used as is if rendered natively at this size)
+    ObsFormat format; // pixel format of the observation
+    size_t stack;     // number of consecutive frames in one observation
+};
+
+// Agent observation stage run after render(): downsampling, color conversion and frame stacking
+class Observation {
+public:
+    explicit Observation(const ObsConfig &config);
+
+    const ObsConfig &config() const;
+    size_t frame_bytes() const; // size of one converted frame
+    size_t bytes() const;       // size of one stacked observation
+
+    // convert fb, push it in the frame ring and write the last config().stack frames (oldest first) in out, which must hold bytes() bytes
+    void process(const FrameBuffer &fb, uint8_t *out);
+
+    void reset(); // forget the previous frames, e.g. at the start of an episode
+
+private:
+    ObsConfig cfg;
+    std::vector<uint8_t> ring;    // the last cfg.stack converted frames
+    size_t head;                  // ring slot of the next frame
+    size_t filled;                // number of valid frames in the ring
+    std::vector<uint32_t> rows;   // vertical box sums, one per source channel
+    std::vector<uint32_t> pixels; // downsampled RGBA frame
+};
+
+// color of a PALETTE observation index
+uint32_t palette_color(const uint8_t index);
+
+#endif // OBSERVATION_H
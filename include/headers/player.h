@@ -2,8 +2,8 @@
 #define PLAYER_H
 
 #include <SDL.h>
-#include <chrono>
 #include <vector>
+#include <cstdint>
 #include <sprite.h>
 
 // Forward declaration of Sprite class
@@ -11,19 +11,35 @@ class Sprite;
 
 #include "map.h"
 
+// Input for one simulation tick, decoupled from SDL events so the game can be driven by agents
+struct Action {
+    int turn, walk; // turn direction and walk direction [-1, 0 or 1]
+    bool shoot;     // fire the gun
+    bool use;       // open the door in front of the player
+};
+
+// One byte encoding of an action, e.g. to send it over the network
+uint8_t encode_action(const Action &action);
+Action decode_action(const uint8_t input);
+
 class Player {
 public:
+    static constexpr int shooting_ticks = 5; // duration of the shooting animation, 100 ms at one tick every 20 ms
+
     float x, y;     // position
     float a;        // view direction [angle in degrees]
     float fov;      // field of view  [radians]
     int turn, walk; // walk direction and turn direction
     bool shooting;  // shooting state
-    std::chrono::time_point<std::chrono::high_resolution_clock> shooting_time; // time when shooting started
+    int shooting_time; // ticks left before the end of the shooting animation
 
     Player(float x, float y, float a, float fov);
 
     void update_position(const Map &map);
     void handle_event(const SDL_Event &event, Map &map, std::vector<Sprite> &monsters);
+    void apply_action(const Action &action, Map &map, std::vector<Sprite> &monsters);
+    void use_door(Map &map);
+    void shoot(std::vector<Sprite> &monsters);
     void check_and_remove_hit_monster(std::vector<Sprite> &monsters);
 };
 
@@ -0,0 +1,80 @@
+#ifndef RAYCASTER_H
+#define RAYCASTER_H
+
+/*
+ * Stable C API of libraycaster, the engine without the SDL front end.
+ * Only fixed-size types cross the boundary, so the library can be used from any language with a C FFI.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define RC_API __declspec(dllexport)
+#else
+#define RC_API __attribute__((visibility("default")))
+#endif
+
+#define RC_API_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct rc_game rc_game;         // opaque game instance
+typedef struct rc_snapshot rc_snapshot; // opaque saved game state
+
+typedef struct {
+    int32_t turn;  // turn direction [-1, 0 or 1]
+    int32_t walk;  // walk direction [-1, 0 or 1]
+    uint8_t shoot; // non-zero to fire the gun
+    uint8_t use;   // non-zero to open the door in front of the player
+    uint8_t reserved[2];
+} rc_action;
+
+typedef struct {
+    const uint32_t *pixels; // RGBA pixels, owned by the game and valid until the next rc_render or rc_destroy
+    size_t width, height;   // frame dimensions in pixels
+    size_t stride;          // distance between two rows in bytes
+} rc_frame;
+
+typedef enum {
+    RC_OBS_RGBA = 0,   // 4 bytes per pixel
+    RC_OBS_GRAY = 1,   // 1 byte per pixel, luma
+    RC_OBS_PALETTE = 2 // 1 byte per pixel, RGB332 palette index
+} rc_obs_format;
+
+RC_API uint32_t rc_api_version(void);
+
+// create a game rendering width x height frames, assets are loaded from asset_dir (NULL for the working directory); NULL on failure
+RC_API rc_game *rc_create(const char *asset_dir, size_t width, size_t height);
+RC_API void rc_destroy(rc_game *game);
+
+RC_API void rc_reset(rc_game *game);                                        // back to the start of the level
+RC_API void rc_step(rc_game *game, const rc_action *action, uint32_t ticks); // apply the action and advance the game by ticks ticks
+RC_API void rc_render(rc_game *game);
+RC_API rc_frame rc_get_frame(const rc_game *game);                         // the last rendered frame, without copy
+
+// per-pixel depth and semantic label buffers filled by rc_render (labels as in SemanticLabel), width*height values each
+RC_API void rc_enable_aux(rc_game *game, int with_depth, int with_labels);
+RC_API const float *rc_get_depth(const rc_game *game);     // NULL if disabled
+RC_API const uint16_t *rc_get_labels(const rc_game *game); // NULL if disabled
+
+// configure the observation stage (size no larger than the frame, rc_obs_format, stacked frames); returns the observation size in bytes, 0 if invalid
+RC_API size_t rc_set_observation(rc_game *game, size_t width, size_t height, uint32_t format, size_t stack);
+RC_API void rc_observe(rc_game *game, uint8_t *out); // turn the last rendered frame into the next observation, written in out
+
+// save states: rc_restore puts the game back in the state of the last rc_save, in microseconds; it returns 0 (game unchanged) if the snapshot was saved on another level
+RC_API rc_snapshot *rc_snapshot_create(void);
+RC_API void rc_snapshot_destroy(rc_snapshot *snapshot);
+RC_API void rc_save(const rc_game *game, rc_snapshot *snapshot);
+RC_API int rc_restore(rc_game *game, const rc_snapshot *snapshot);
+
+RC_API void rc_get_player(const rc_game *game, float *x, float *y, float *a);
+RC_API size_t rc_monster_count(const rc_game *game);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RAYCASTER_H
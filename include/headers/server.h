@@ -0,0 +1,103 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+#include <chrono>
+
+#include "tinyraycaster.h"
+#include "transport.h"
+#include "threadpool.h"
+
+// Messages between the game server and its clients, the first byte of every datagram
+enum MessageType : uint8_t {
+    MSG_JOIN    = 1, // client -> server: [token u32], asks for a new session (repeat until welcomed, the same token gets the same session)
+    MSG_WELCOME = 2, // server -> client: [token u32][session u32]
+    MSG_INPUT   = 3, // client -> server: [session u32][ack u32][input u8], ack is the last state tick received
+    MSG_LEAVE   = 4, // client -> server: [session u32]
+    MSG_STATE   = 5  // server -> client: [session u32] then the delta-compressed state, see encode_state()
+};
+
+static constexpr uint32_t no_base = 0xFFFFFFFF; // base tick of a full (not delta-compressed) state
+
+// What a client knows of a session: the base of the delta compression, on both sides
+struct SessionFrame {
+    uint32_t tick = 0;
+    float x = 0, y = 0, a = 0;                    // player
+    bool shooting = false;
+    std::vector<Sprite> monsters;                 // sorted by id
+    std::vector<std::pair<uint32_t, char>> cells; // map cells differing from the base layout (opened doors)
+};
+
+// Capture the part of gs sent to clients
+void capture_frame(const GameState &gs, SessionFrame &frame);
+
+// Append to packet the state of frame, as a delta against base (nullptr for a full state): only the changed monsters and cells are written
+void encode_state(const SessionFrame &frame, const SessionFrame *base, std::vector<uint8_t> &packet);
+
+// Rebuild a frame from a state packet body; base must be the frame of the base tick given in the packet (ignored for a full state)
+bool decode_state(const uint8_t *data, const size_t size, const SessionFrame *base, SessionFrame &frame, uint32_t &base_tick);
+
+struct ServerConfig {
+    uint16_t port = 27960;
+    size_t threads = 0;         // worker threads, 0 for one per core
+    bool pin_threads = false;   // bind each worker thread to its own core (Linux)
+    double tick_ms = 20;        // simulation period
+    double timeout_s = 5;       // sessions without input for this long are closed
+    size_t max_sessions = 100000;
+};
+
+// Authoritative headless server running many independent sessions, each one a GameState with its own map
+class GameServer {
+public:
+    GameServer(const GameState &initial, const ServerConfig &config);
+
+    bool ok() const;
+    void tick();                             // read the network, simulate every session, send the states
+    void run(const std::atomic<bool> &stop); // tick at the configured period until stop is set
+
+    size_t sessions() const;
+    double busy_ms() const;        // average time spent in tick() over the last report period
+    size_t bytes_sent() const;     // total payload bytes sent
+    size_t full_states() const;    // states sent without delta compression
+    size_t delta_states() const;   // states sent as deltas
+
+private:
+    static constexpr size_t history = 32; // frames kept per session as delta bases
+
+    struct Session {
+        uint32_t id;
+        size_t peer;
+        uint32_t token;     // chosen by the client in its join request
+        GameState gs;
+        uint8_t input;      // last input received, shooting and doors are consumed once
+        uint32_t acked;     // last state tick the client received
+        std::vector<SessionFrame> frames; // frame sent at tick t, in slot t % history
+        std::chrono::steady_clock::time_point last_heard;
+        std::vector<uint8_t> out; // state packet built by the workers
+        bool delta;
+    };
+
+    ServerConfig cfg;
+    GameState initial;
+    UdpTransport transport;
+    ThreadPool pool;
+    std::vector<Session> list;
+    std::unordered_map<uint32_t, size_t> index;   // session id -> position in list
+    std::unordered_map<uint64_t, uint32_t> joins; // (peer, token) -> session id, so that repeated join requests get the same session
+    uint32_t next_id;
+    std::vector<uint8_t> packet;
+    size_t sent, full_count, delta_count;
+    double busy_total;
+    size_t busy_ticks;
+    double busy_average;
+
+    Session *find(const uint32_t id, const size_t peer);
+    void remove(const uint32_t id);
+    void handle_packet(const size_t peer);
+    void drop_silent_sessions();
+};
+
+#endif // SERVER_H
@@ -0,0 +1,41 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <vector>
+
+#include "tinyraycaster.h"
+
+// Binary image of the mutable part of a GameState: tick, player, monsters and the map cells that differ from the base layout
+class Snapshot {
+public:
+    explicit Snapshot(const size_t capacity = 4096); // capacity in bytes, preallocated so that saving does not allocate
+
+    void save(const GameState &gs);
+    // gs must share the map base layout and the textures of the saved state; false (gs unchanged) if the snapshot does not fit it or is malformed
+    bool restore(GameState &gs) const;
+
+    // same, with the players of a multiplayer session
+    void save(const GameState &gs, const std::vector<Player> &players);
+    bool restore(GameState &gs, std::vector<Player> &players) const;
+
+    const uint8_t *data() const;
+    size_t size() const;                         // number of bytes used by the last save
+    bool load(const uint8_t *bytes, const size_t n); // copy a snapshot serialized elsewhere, e.g. received from the network; false (and empty) if malformed
+
+private:
+    std::vector<uint8_t> buffer;
+    size_t used;
+    mutable std::vector<std::pair<uint32_t, char>> cells; // scratch list of modified map cells
+
+    template <typename T> void write(const T &value);
+    template <typename T> T read(size_t &offset) const;
+    template <typename T> bool read_checked(size_t &offset, T &value) const;
+    bool check_player(size_t &offset) const;
+    bool check(const size_t map_cells, const size_t monster_frames, const size_t wall_textures, bool &players) const;
+    void write_player(const Player &p);
+    void read_player(Player &p, size_t &offset) const;
+    size_t restore_state(GameState &gs) const; // returns the offset of the players list
+};
+
+#endif // SNAPSHOT_H
@@ -2,6 +2,7 @@
 #define SPRITE_H
 
 #include <cstdlib>
+#include <cstdint>
 
 // Forward declaration of Player class
 class Player;
@@ -11,6 +12,7 @@ struct Sprite {
     float x, y;
     size_t tex_id;
     float player_dist;
+    uint32_t id = 0; // stable identifier, the index in the monsters list changes when they are sorted or killed
     
     bool operator < (const Sprite& s) const;
     void update_position(const Player& player, const Map& map, float speed);
@@ -0,0 +1,61 @@
+#ifndef SPRITECACHE_H
+#define SPRITECACHE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+#include "textures.h"
+
+// A sprite frame scaled to size x size texels, stored column by column: the texel (i, j) is texels[i * size + j]
+struct SpriteImage {
+    const uint32_t *texels;
+    size_t size;
+    const void *entry; // pin in the cache, for SpriteCache::release
+};
+
+// Process-wide cache of the sprite frames pre-scaled to power of two sizes (impostors): the level 0 of a frame
+// has the size of the texture, every next level half of it, each texel averaging 2x2 texels of the previous one
+class SpriteCache {
+public:
+    explicit SpriteCache(const size_t budget = 4 << 20);
+
+    SpriteCache(const SpriteCache&) = delete;
+    SpriteCache& operator=(const SpriteCache&) = delete;
+
+    // image of the level of the frame idx of texture, built on first use and pinned until released
+    SpriteImage acquire(const std::shared_ptr<const Texture> &texture, const size_t idx, const size_t level);
+    void release(const SpriteImage &image);
+
+    // level whose size is the smallest not below screen_size, 0 for sprites at least as large as the texture
+    static size_t level_for(const size_t tex_size, const size_t screen_size);
+
+    void set_budget(const size_t bytes); // bytes of images kept while no frame uses them
+    size_t bytes() const;                // bytes of all the images
+    size_t size() const;                 // number of images
+
+    static SpriteCache &shared();
+
+private:
+    struct Entry {
+        std::weak_ptr<const Texture> texture; // the key, with idx and level
+        const Texture *texture_key;
+        size_t idx, level;
+        std::vector<uint32_t> texels;
+        size_t size;
+        size_t users;      // frames using the image, which cannot be evicted meanwhile
+        uint64_t last_use; // for the least recently used eviction
+    };
+
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<Entry>> entries;
+    size_t budget, total_bytes;
+    uint64_t clock;
+
+    Entry *build(const std::shared_ptr<const Texture> &texture, const size_t idx, const size_t level);
+    void evict();
+};
+
+#endif // SPRITECACHE_H
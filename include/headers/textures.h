@@ -3,6 +3,8 @@
 
 #include <vector>
 #include <cstdint>
+#include <string>
+#include <memory>
 
 struct Texture {
     size_t img_w, img_h;       // overall image dimensions
@@ -14,8 +16,24 @@ struct Texture {
     // get the pixel (i,j) from the texture idx
     uint32_t get(const size_t i, const size_t j, const size_t idx) const; 
 
+    // pointer to the pixel (i,0) of the texture idx, the pixels below it are img_w apart
+    const uint32_t *column(const size_t i, const size_t idx) const;
+
     // retrieve one column (tex_coord) from the texture texture_id and scale it to the destination size
     std::vector<uint32_t> get_scaled_column(const size_t texture_id, const size_t tex_coord, const size_t column_height) const; 
+
+    // same, writing into column (column_height pixels, e.g. from the FrameArena) instead of allocating
+    void get_scaled_column(const size_t texture_id, const size_t tex_coord, const size_t column_height, uint32_t *column) const;
+};
+
+// Process-wide cache handing out shared immutable textures, keyed by file name and pixel format
+class TextureCache {
+public:
+    // load the texture or return the copy already in use
+    static std::shared_ptr<const Texture> load(const std::string &filename, const uint32_t format);
+
+    static void purge();  // drop the entries whose texture is no longer used by anyone
+    static size_t size(); // number of entries still alive
 };
 
 #endif // TEXTURES_H
\ No newline at end of file
@@ -0,0 +1,90 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <cstdlib>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+#include "alloctrack.h"
+
+// Number of jobs not finished yet, e.g. the parts of a parallel loop; a job can wait for a counter to reach 0
+struct JobCounter {
+    std::atomic<size_t> pending{0};
+};
+
+// A range of iterations of a loop, run by fn(data, begin, end)
+struct Job {
+    void (*fn)(void *data, size_t begin, size_t end);
+    void *data;
+    size_t begin, end;
+    JobCounter *counter; // decremented when the job is done, may be nullptr
+    AllocTag tag = ALLOC_UNTAGGED; // charged for the allocations of fn, set to the tag of the thread queuing the job
+};
+
+// Persistent worker threads, one per core, running jobs from work-stealing queues
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads = 0, const bool pin = false); // 0 means one thread per core; pin binds each worker to its own core (Linux)
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const; // number of threads, the caller included
+
+    // queue a job, counted in job.counter, to be run by any thread
+    void submit(const Job &job);
+
+    // run queued jobs until counter reaches 0
+    void wait(JobCounter &counter);
+
+    // call fn(begin, end) over ranges of at most grain iterations (0 to choose) covering [0, n) and wait for all of them
+    void parallel_for_range(const size_t n, const size_t grain, const std::function<void(size_t, size_t)> &fn);
+
+    // call fn(i) for every i in [0, n) and wait for all of them to complete
+    void parallel_for(const size_t n, const std::function<void(size_t)> &fn);
+
+    // same for any callable, wrapped by reference so that large lambdas do not allocate a std::function on every call
+    template<typename F> void parallel_for(const size_t n, const F &fn) {
+        parallel_for(n, std::function<void(size_t)>(std::cref(fn)));
+    }
+    template<typename F> void parallel_for_range(const size_t n, const size_t grain, const F &fn) {
+        parallel_for_range(n, grain, std::function<void(size_t, size_t)>(std::cref(fn)));
+    }
+
+    static ThreadPool &shared(); // engine-wide pool with one thread per core, for the code that has no pool of its own
+
+private:
+    // Bounded double-ended queue: its owner pushes and pops at the back, the other threads steal from the front
+    struct Queue {
+        static constexpr size_t capacity = 1024;
+        std::mutex mutex;
+        Job jobs[capacity];
+        size_t head = 0, tail = 0; // jobs in [head, tail), indices modulo capacity
+
+        bool push(const Job &job);
+        bool pop(Job &job);
+        bool steal(Job &job);
+    };
+
+    std::vector<std::thread> workers;
+    std::unique_ptr<Queue[]> queues;  // one per worker, plus the last one shared by the threads outside the pool
+    std::mutex mutex;                 // protects the sleeping threads
+    std::condition_variable wake;
+    std::atomic<size_t> queued;       // jobs in all the queues
+    std::atomic<size_t> sleeping;     // threads waiting on wake
+    bool quit;
+
+    size_t queue_index() const;       // queue owned by the calling thread
+    bool take(const size_t own, Job &job);
+    void run(const Job &job);
+    void notify();
+    void worker_loop(const size_t index);
+};
+
+#endif // THREADPOOL_H
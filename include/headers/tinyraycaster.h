@@ -2,6 +2,8 @@
 #define TINYRAYCASTER_H
 
 #include <vector>
+#include <memory>
+#include <string>
 #include <SDL.h>
 
 #include "map.h"
@@ -10,16 +12,66 @@
 #include "framebuffer.h"
 #include "textures.h"
 
+class ThreadPool;
+
+// Semantic labels written by render() in FrameBuffer::labels
+enum SemanticLabel : uint16_t {
+    LABEL_NONE    = 0,
+    LABEL_CEILING = 1,
+    LABEL_FLOOR   = 2,
+    LABEL_DOOR    = 3,
+    LABEL_HUD     = 4,   // minimap and gun
+    LABEL_FOG     = 5,   // beyond RenderSettings::draw_distance
+    LABEL_WALL    = 16,  // + wall texture id
+    LABEL_MONSTER = 256  // + index of the monster in GameState::monsters
+};
+
+// Options of render(), the defaults draw the reference frames
+struct RenderSettings {
+    bool sprite_lod = false;      // draw the sprites smaller than their texture from pre-scaled images (see SpriteCache)
+    size_t min_sprite_size = 0;   // sprites smaller than this on the screen, in pixels, are not drawn
+    float sprite_distance = 15;   // sprites farther than this are not drawn
+
+    float draw_distance = 0;      // walls, floor, ceiling and sprites farther than this are hidden by the fog, 0 for no limit
+    float fog_start = 0.5f;       // fraction of draw_distance where the fog starts, growing to hide everything at draw_distance
+    uint32_t fog_color = 0xFF808080;
+
+    // weight of the fog at a distance, from 0 (none) to 256 (only fog)
+    uint32_t fog_weight(const float dist) const {
+        if (draw_distance <= 0) return 0;
+        const float start = draw_distance * fog_start;
+        if (dist <= start) return 0;
+        if (dist >= draw_distance) return 256;
+        return static_cast<uint32_t>((dist - start) / (draw_distance - start) * 256);
+    }
+};
+
 struct GameState {
     Map map;
     Player player;
     std::vector<Sprite> monsters;
-    Texture tex_walls;
-    Texture tex_monst;
-    Texture tex_gun;
+    std::shared_ptr<const Texture> tex_walls; // textures are immutable and shared between game instances
+    std::shared_ptr<const Texture> tex_monst;
+    std::shared_ptr<const Texture> tex_gun;
+    uint32_t tick = 0; // number of simulated ticks since the start of the level
 };
 
-// Render the game state to the framebuffer
-void render(FrameBuffer &fb, const GameState &gs, SDL_Renderer* renderer);
+// Build the initial state of the level, loading the textures found in asset_dir (empty for the working directory)
+GameState new_game(const std::string &asset_dir);
+
+// Advance the game state by one tick (player and monsters) without anything needed only for rendering
+void simulate(GameState &gs);
+
+// Update the distances of the monsters from the player and sort them from farthest to closest, as render() expects
+void sort_monsters(GameState &gs);
+
+// Advance the game state by one tick and prepare it for rendering
+void update(GameState &gs);
+
+// Apply an action and simulate repeat ticks (the walk and turn directions are repeated, shooting and doors happen once), ready for rendering
+void step(GameState &gs, const Action &action, const size_t repeat = 1);
+
+// Render the game state to the framebuffer with the passes of standard_frame_graph() (see framegraph.h), in parallel on pool if given
+void render(FrameBuffer &fb, const GameState &gs, SDL_Renderer* renderer, ThreadPool *pool = nullptr);
 
 #endif // TINYRAYCASTER_H
\ No newline at end of file
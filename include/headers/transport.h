@@ -0,0 +1,94 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <string>
+#include <random>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+// Unreliable datagram channel between numbered peers
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    virtual void send(const size_t peer, const uint8_t *data, const size_t size) = 0;
+
+    // non-blocking: returns false when no packet is waiting, otherwise fills the sender and the payload
+    virtual bool receive(size_t &peer, std::vector<uint8_t> &packet) = 0;
+};
+
+struct Endpoint {
+    std::string host; // IPv4 address, e.g. "127.0.0.1"
+    uint16_t port;
+};
+
+// Transport over a UDP socket; peers are the given endpoints, senders not in the list are appended to it when their first packet arrives
+class UdpTransport : public Transport {
+public:
+    UdpTransport(const uint16_t port, const std::vector<Endpoint> &peers = {}); // port 0 picks a free port
+    ~UdpTransport() override;
+
+    UdpTransport(const UdpTransport&) = delete;
+    UdpTransport& operator=(const UdpTransport&) = delete;
+
+    bool ok() const;         // the socket is open and bound
+    uint16_t port() const;   // the bound port
+    size_t peers() const;
+
+    void send(const size_t peer, const uint8_t *data, const size_t size) override;
+    bool receive(size_t &peer, std::vector<uint8_t> &packet) override;
+
+private:
+    intptr_t sock;
+    uint16_t bound_port;
+    std::vector<std::pair<uint32_t, uint16_t>> addresses; // peers as (IPv4 address, port), in network byte order
+};
+
+// In-process stand-in for UDP: every endpoint of a hub can send to every other one, packets are delivered immediately
+class LoopbackHub {
+public:
+    explicit LoopbackHub(const size_t peers);
+
+    Transport &endpoint(const size_t peer);
+
+private:
+    struct Port : Transport {
+        LoopbackHub *hub;
+        size_t self;
+        void send(const size_t peer, const uint8_t *data, const size_t size) override;
+        bool receive(size_t &peer, std::vector<uint8_t> &packet) override;
+    };
+
+    std::mutex mutex;
+    std::vector<Port> ports;
+    std::vector<std::deque<std::pair<size_t, std::vector<uint8_t>>>> queues; // pending (sender, payload) per receiver
+};
+
+// Wraps a transport to simulate latency, jitter and loss on outgoing packets
+class LossyTransport : public Transport {
+public:
+    LossyTransport(Transport &inner, const double latency_ms, const double jitter_ms, const double loss, const uint32_t seed = 1);
+
+    void send(const size_t peer, const uint8_t *data, const size_t size) override;
+    bool receive(size_t &peer, std::vector<uint8_t> &packet) override;
+
+private:
+    struct Delayed {
+        std::chrono::steady_clock::time_point due;
+        size_t peer;
+        std::vector<uint8_t> data;
+    };
+
+    Transport &inner;
+    double latency_ms, jitter_ms, loss;
+    std::mt19937 rng;
+    std::vector<Delayed> delayed; // packets waiting for their delivery time
+
+    void flush(); // hand the due packets to the inner transport
+};
+
+#endif // TRANSPORT_H
@@ -0,0 +1,115 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+
+#include "../include/headers/server.h"
+
+/**
+ * @file loadgen.cpp
+ * @brief Load generator for the headless DoomClone server.
+ *
+ * Usage: DoomLoadgen [host] [port] [sessions] [seconds] [tick_ms]
+ *
+ * Opens the given number of sessions from one socket, sends random inputs every tick,
+ * rebuilds every session from the delta-compressed states and reports the received
+ * states per second, their average size and the decoding failures.
+ */
+
+struct Client {
+    uint32_t session = 0;
+    uint32_t acked = no_base;          // last state tick decoded, acknowledged with the inputs
+    std::vector<SessionFrame> frames;  // decoded frames, in slot tick % frames.size()
+};
+
+int main(int argc, char **argv) {
+    const std::string host = argc > 1 ? argv[1] : "127.0.0.1";
+    const uint16_t port = static_cast<uint16_t>(argc > 2 ? std::atoi(argv[2]) : 27960);
+    const size_t count = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 100;
+    const double seconds = argc > 4 ? std::atof(argv[4]) : 10;
+    const double tick_ms = argc > 5 ? std::atof(argv[5]) : 20;
+
+    UdpTransport transport(0, { {host, port} });
+    if (!transport.ok()) return -1;
+
+    std::vector<Client> clients(count);
+    std::vector<uint8_t> packet;
+    for (Client &c : clients) {
+        c.frames.resize(64);
+    }
+
+    std::mt19937 rng(1);
+    size_t states = 0, bytes = 0, failures = 0;
+    const auto start = std::chrono::steady_clock::now();
+    auto next = start;
+    auto report = start + std::chrono::seconds(1);
+    while (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < seconds) {
+        size_t peer;
+        while (transport.receive(peer, packet)) {
+            uint32_t token, id;
+            if (packet.size() >= 9 && packet[0] == MSG_WELCOME) {
+                std::memcpy(&token, packet.data() + 1, 4);
+                std::memcpy(&id, packet.data() + 5, 4);
+                if (token < count && !clients[token].session) clients[token].session = id;
+            } else if (packet.size() >= 5 && packet[0] == MSG_STATE) {
+                std::memcpy(&id, packet.data() + 1, 4);
+                uint32_t tick, base_tick;
+                if (packet.size() < 13) continue;
+                std::memcpy(&tick, packet.data() + 5, 4);
+                std::memcpy(&base_tick, packet.data() + 9, 4);
+                for (Client &c : clients) { // the load generator favours simplicity over lookup speed
+                    if (c.session != id) continue;
+                    const SessionFrame *base = base_tick == no_base ? nullptr : &c.frames[base_tick % c.frames.size()];
+                    SessionFrame &frame = c.frames[tick % c.frames.size()];
+                    uint32_t decoded_base;
+                    if (decode_state(packet.data() + 5, packet.size() - 5, base, frame, decoded_base)) {
+                        if (c.acked == no_base || tick > c.acked) c.acked = tick;
+                        states++;
+                        bytes += packet.size();
+                    } else {
+                        failures++;
+                    }
+                    break;
+                }
+            }
+        }
+
+        for (uint32_t token = 0; token < count; token++) {
+            Client &c = clients[token];
+            if (!c.session) { // join, again every tick until welcomed since datagrams can be lost
+                packet.clear();
+                packet.push_back(MSG_JOIN);
+                packet.insert(packet.end(), reinterpret_cast<const uint8_t *>(&token), reinterpret_cast<const uint8_t *>(&token) + 4);
+                transport.send(0, packet.data(), packet.size());
+                continue;
+            }
+            Action action{ int(rng() % 3) - 1, int(rng() % 3) - 1, rng() % 50 == 0, rng() % 20 == 0 };
+            packet.clear();
+            packet.push_back(MSG_INPUT);
+            packet.insert(packet.end(), reinterpret_cast<const uint8_t *>(&c.session), reinterpret_cast<const uint8_t *>(&c.session) + 4);
+            packet.insert(packet.end(), reinterpret_cast<const uint8_t *>(&c.acked), reinterpret_cast<const uint8_t *>(&c.acked) + 4);
+            packet.push_back(encode_action(action));
+            transport.send(0, packet.data(), packet.size());
+        }
+
+        if (std::chrono::steady_clock::now() >= report) {
+            std::cout << "states/s " << states << " | avg " << (states ? bytes / states : 0) << " bytes | decode failures " << failures << std::endl;
+            states = bytes = 0;
+            report += std::chrono::seconds(1);
+        }
+        next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(tick_ms));
+        std::this_thread::sleep_until(next);
+    }
+
+    for (Client &c : clients) {
+        if (!c.session) continue;
+        packet.clear();
+        packet.push_back(MSG_LEAVE);
+        packet.insert(packet.end(), reinterpret_cast<const uint8_t *>(&c.session), reinterpret_cast<const uint8_t *>(&c.session) + 4);
+        transport.send(0, packet.data(), packet.size());
+    }
+    return 0;
+}
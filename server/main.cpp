@@ -0,0 +1,39 @@
+#include <iostream>
+#include <csignal>
+#include <cstdlib>
+#include <atomic>
+
+#include "../include/headers/server.h"
+
+/**
+ * @file main.cpp
+ * @brief Entry point of the headless DoomClone server.
+ *
+ * Usage: DoomServer [port] [threads] [tick_ms] [pin]
+ *
+ * A pin argument of 1 binds each worker thread to its own core.
+ *
+ * Every client joining gets its own session, simulated by the server and streamed back
+ * as delta-compressed states. No window, renderer or texture is needed.
+ */
+
+static std::atomic<bool> stop(false);
+
+int main(int argc, char **argv) {
+    ServerConfig config;
+    if (argc > 1) config.port = static_cast<uint16_t>(std::atoi(argv[1]));
+    if (argc > 2) config.threads = std::strtoul(argv[2], nullptr, 10);
+    if (argc > 3) config.tick_ms = std::atof(argv[3]);
+    if (argc > 4) config.pin_threads = std::atoi(argv[4]) != 0;
+
+    GameServer server(new_game(""), config);
+    if (!server.ok()) {
+        std::cerr << "Failed to start the server on port " << config.port << std::endl;
+        return -1;
+    }
+
+    std::signal(SIGINT, [](int) { stop = true; });
+    std::cout << "DoomClone server listening on UDP port " << config.port << std::endl;
+    server.run(stop);
+    return 0;
+}
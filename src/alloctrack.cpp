@@ -0,0 +1,164 @@
+#include <cstdlib>
+#include <new>
+#include <atomic>
+
+#include "../include/headers/alloctrack.h"
+
+static const char *tag_names[ALLOC_TAGS] = { "untagged", "simulation", "render", "observation", "network" };
+
+AllocCounters AllocStats::total() const {
+    AllocCounters sum;
+    for (const AllocCounters &tag : tags) {
+        sum.count += tag.count;
+        sum.bytes += tag.bytes;
+    }
+    return sum;
+}
+
+/**
+ * @brief Prints the counters of every tag that allocated.
+ * 
+ * Only stdio is used, so the report can be printed while the strict mode is on.
+ * 
+ * @param out The stream to print to.
+ * @param stats The counters, e.g. from alloc_frame() or alloc_stats().
+ */
+void alloc_report(FILE *out, const AllocStats &stats) {
+    const AllocCounters total = stats.total();
+    fprintf(out, "allocations %llu (%llu bytes), live %lld bytes\n", (unsigned long long)total.count, (unsigned long long)total.bytes, (long long)stats.live_bytes);
+    for (size_t i = 0; i < ALLOC_TAGS; i++) {
+        if (!stats.tags[i].count) continue;
+        fprintf(out, "  %-12s %llu (%llu bytes)\n", tag_names[i], (unsigned long long)stats.tags[i].count, (unsigned long long)stats.tags[i].bytes);
+    }
+}
+
+#ifdef TRACK_ALLOCATIONS
+
+// Counters are plain relaxed atomics: they are only read to build reports
+static std::atomic<uint64_t> counts[ALLOC_TAGS];
+static std::atomic<uint64_t> bytes[ALLOC_TAGS];
+static std::atomic<int64_t> live;
+static thread_local AllocTag current = ALLOC_UNTAGGED;
+
+static AllocStats last_frame;         // counters of the last closed frame
+static AllocStats frame_start;        // alloc_stats() when the current frame started
+static uint64_t frames = 0;           // frames closed so far
+static uint64_t strict_warmup = 0;    // 0 when the strict mode is off
+static std::atomic<bool> strict{false};
+
+// Every block starts with a header holding its size, so that delete can account for it
+static constexpr size_t header = alignof(std::max_align_t);
+
+static void *tracked_alloc(const size_t n) {
+    const AllocTag tag = current;
+    if (tag != ALLOC_UNTAGGED && strict.load(std::memory_order_relaxed)) {
+        fprintf(stderr, "Allocation of %zu bytes in stage %s after %llu warmup frames\n", n, tag_names[tag], (unsigned long long)strict_warmup);
+        std::abort();
+    }
+    unsigned char *block = static_cast<unsigned char*>(std::malloc(n + header));
+    if (!block) throw std::bad_alloc();
+    *reinterpret_cast<size_t*>(block) = n;
+    counts[tag].fetch_add(1, std::memory_order_relaxed);
+    bytes[tag].fetch_add(n, std::memory_order_relaxed);
+    live.fetch_add(n, std::memory_order_relaxed);
+    return block + header;
+}
+
+static void tracked_free(void *p) {
+    if (!p) return;
+    unsigned char *block = static_cast<unsigned char*>(p) - header;
+    live.fetch_sub(*reinterpret_cast<size_t*>(block), std::memory_order_relaxed);
+    std::free(block);
+}
+
+// The array, nothrow and sized forms of the standard library all end up here
+void *operator new(size_t n) { return tracked_alloc(n); }
+void operator delete(void *p) noexcept { tracked_free(p); }
+void operator delete(void *p, size_t) noexcept { tracked_free(p); }
+
+AllocScope::AllocScope(const AllocTag tag) : previous(current) {
+    current = tag;
+}
+
+AllocScope::~AllocScope() {
+    current = previous;
+}
+
+bool alloc_tracking() {
+    return true;
+}
+
+AllocTag alloc_tag() {
+    return current;
+}
+
+AllocStats alloc_stats() {
+    AllocStats stats;
+    for (size_t i = 0; i < ALLOC_TAGS; i++) {
+        stats.tags[i].count = counts[i].load(std::memory_order_relaxed);
+        stats.tags[i].bytes = bytes[i].load(std::memory_order_relaxed);
+    }
+    stats.live_bytes = live.load(std::memory_order_relaxed);
+    return stats;
+}
+
+AllocStats alloc_frame() {
+    return last_frame;
+}
+
+void alloc_strict(const uint64_t warmup) {
+    strict_warmup = warmup;
+    strict = warmup && frames >= warmup;
+}
+
+/**
+ * @brief Closes the current frame.
+ * 
+ * The difference between the counters now and at the end of the previous frame becomes the
+ * result of alloc_frame(). On the first call the DOOM_ALLOC_STRICT environment variable is
+ * read: once that many frames are closed, any allocation made inside an AllocScope aborts the
+ * process, naming the stage that allocated.
+ */
+void alloc_frame_end() {
+    static const bool from_env = [] {
+        const char *env = std::getenv("DOOM_ALLOC_STRICT");
+        if (env) alloc_strict(std::strtoull(env, nullptr, 10));
+        return env != nullptr;
+    }();
+    (void)from_env;
+
+    const AllocStats now = alloc_stats();
+    for (size_t i = 0; i < ALLOC_TAGS; i++) {
+        last_frame.tags[i].count = now.tags[i].count - frame_start.tags[i].count;
+        last_frame.tags[i].bytes = now.tags[i].bytes - frame_start.tags[i].bytes;
+    }
+    last_frame.live_bytes = now.live_bytes;
+    frame_start = now;
+
+    frames++;
+    if (strict_warmup && frames >= strict_warmup) strict = true;
+}
+
+#else
+
+bool alloc_tracking() {
+    return false;
+}
+
+AllocTag alloc_tag() {
+    return ALLOC_UNTAGGED;
+}
+
+AllocStats alloc_stats() {
+    return AllocStats();
+}
+
+AllocStats alloc_frame() {
+    return AllocStats();
+}
+
+void alloc_strict(const uint64_t) {}
+
+void alloc_frame_end() {}
+
+#endif // TRACK_ALLOCATIONS
@@ -0,0 +1,92 @@
+#include <cassert>
+#include <algorithm>
+
+#include "../include/headers/arena.h"
+
+/**
+ * @brief Creates an arena with the given initial capacity.
+ * 
+ * @param capacity The size of the main block in bytes.
+ */
+FrameArena::FrameArena(const size_t capacity) : block(new unsigned char[capacity]), block_size(capacity), offset(0), overflow_bytes(0) {}
+
+/**
+ * @brief Hands out bytes from the main block, or from a new overflow block if it is full.
+ * 
+ * Overflow blocks only exist until the next reset(), which grows the main block so that
+ * the same workload fits in it from then on: once warmed up, a frame does not touch the heap.
+ * 
+ * @param bytes The number of bytes to allocate.
+ * @param align The alignment of the result, a power of two not larger than alignof(std::max_align_t).
+ * @return The allocated memory.
+ */
+void *FrameArena::alloc_bytes(const size_t bytes, const size_t align) {
+    assert(align && !(align & (align - 1)) && align <= alignof(std::max_align_t));
+    size_t start = (offset + align - 1) & ~(align - 1);
+    if (start + bytes <= block_size) {
+        offset = start + bytes;
+        return block.get() + start;
+    }
+    overflow.emplace_back(new unsigned char[bytes ? bytes : 1]);
+    overflow_bytes += bytes;
+    return overflow.back().get();
+}
+
+/**
+ * @brief Releases everything allocated since the last reset.
+ * 
+ * If the main block overflowed, it is replaced by one large enough for the peak usage, and
+ * at least twice as large as before so that a slowly growing workload (e.g. more and more
+ * sprites on the screen) only overflows a few times.
+ * Pointers handed out before the call must not be used afterwards.
+ */
+void FrameArena::reset() {
+    if (!overflow.empty()) {
+        size_t peak = std::max(offset + overflow_bytes + overflow.size() * alignof(std::max_align_t), 2 * block_size);
+        block.reset(new unsigned char[peak]);
+        block_size = peak;
+        overflow.clear();
+        overflow_bytes = 0;
+    }
+    offset = 0;
+}
+
+size_t FrameArena::mark() const {
+    return used();
+}
+
+/**
+ * @brief Releases everything allocated since the given mark.
+ * 
+ * Once the main block overflowed, memory is only released by a rewind to 0, which is a
+ * reset(): an inner scope (e.g. a frame rendered by a worker while it waits inside another
+ * frame) leaves it to the outermost one.
+ * 
+ * @param mark The value of mark() at the start of the scope.
+ */
+void FrameArena::rewind(const size_t mark) {
+    assert(mark <= used());
+    if (!mark) reset();
+    else if (overflow.empty()) offset = mark;
+}
+
+size_t FrameArena::used() const {
+    return offset + overflow_bytes;
+}
+
+size_t FrameArena::capacity() const {
+    return block_size;
+}
+
+/**
+ * @brief Returns the arena of the calling thread.
+ * 
+ * Every thread rendering frames (the main loop, the workers of a BatchEnv) gets its own
+ * arena, so no locking is needed.
+ * 
+ * @return The arena, created on the first call from the thread.
+ */
+FrameArena &FrameArena::local() {
+    thread_local FrameArena arena;
+    return arena;
+}
@@ -0,0 +1,122 @@
+#include <cassert>
+#include <cstring>
+
+#include "../include/headers/batch.h"
+
+/**
+ * @brief Creates count copies of the initial game state and the worker threads used to run them.
+ * 
+ * The textures are held through shared pointers, so all the instances use the ones already
+ * loaded in the initial state and no image data is duplicated.
+ * 
+ * @param initial The state every instance starts from (and goes back to on reset).
+ * @param count The number of game instances.
+ * @param frame_w The width of the rendered observations.
+ * @param frame_h The height of the rendered observations.
+ * @param threads The number of threads, 0 to use the engine-wide pool (one thread per hardware core).
+ */
+BatchEnv::BatchEnv(const GameState &initial, const size_t count, const size_t frame_w, const size_t frame_h, const size_t threads) :
+    frame_w(frame_w), frame_h(frame_h), initial(initial), envs(count, initial),
+    own_pool(threads ? new ThreadPool(threads) : nullptr), pool(threads ? *own_pool : ThreadPool::shared()) {}
+
+size_t BatchEnv::size() const {
+    return envs.size();
+}
+
+size_t BatchEnv::frame_size() const {
+    return frame_w * frame_h;
+}
+
+GameState &BatchEnv::env(const size_t i) {
+    assert(i < envs.size());
+    return envs[i];
+}
+
+const GameState &BatchEnv::env(const size_t i) const {
+    assert(i < envs.size());
+    return envs[i];
+}
+
+void BatchEnv::reset(const size_t i) {
+    assert(i < envs.size());
+    envs[i] = initial;
+    if (!observations.empty()) observations[i].reset();
+}
+
+void BatchEnv::reset_all() {
+    pool.parallel_for(envs.size(), [&](size_t i) { reset(i); });
+}
+
+/**
+ * @brief Applies one action per instance and advances every instance by repeat ticks.
+ * 
+ * The instances are independent, so they are updated in parallel across the pool.
+ * 
+ * @param actions The actions to apply, one for each instance.
+ * @param repeat The number of ticks each action is repeated for.
+ */
+void BatchEnv::step(const std::vector<Action> &actions, const size_t repeat) {
+    assert(actions.size() == envs.size());
+    pool.parallel_for(envs.size(), [&](size_t i) {
+        ::step(envs[i], actions[i], repeat);
+    });
+}
+
+/**
+ * @brief Renders every instance into one contiguous buffer.
+ * 
+ * Each thread renders into its own framebuffer, reused from one call to the next, and
+ * copies the result in the slot of the instance.
+ * 
+ * @param out The destination buffer, size()*frame_size() pixels.
+ */
+void BatchEnv::render(uint32_t *out) {
+    pool.parallel_for(envs.size(), [&](size_t i) {
+        FrameBuffer &fb = render_instance(i);
+        std::memcpy(out + i*frame_size(), fb.img.data(), frame_size()*sizeof(uint32_t));
+    });
+}
+
+/**
+ * @brief Renders the instance i into the framebuffer of the calling thread.
+ * 
+ * @param i The instance to render.
+ * @return The framebuffer, valid until the next call from the same thread.
+ */
+FrameBuffer &BatchEnv::render_instance(const size_t i) {
+    thread_local FrameBuffer fb{0, 0, {}};
+    if (fb.w != frame_w || fb.h != frame_h) {
+        fb = FrameBuffer{frame_w, frame_h, std::vector<uint32_t>(frame_w*frame_h)};
+    }
+    ::render(fb, envs[i], nullptr);
+    return fb;
+}
+
+/**
+ * @brief Enables the observation stage for every instance.
+ * 
+ * Setting frame_w and frame_h to the observation size renders the observations natively
+ * instead of box-filtering full size frames.
+ * 
+ * @param config The observation size, format and number of stacked frames.
+ */
+void BatchEnv::set_observation(const ObsConfig &config) {
+    assert(config.w <= frame_w && config.h <= frame_h);
+    observations.assign(envs.size(), Observation(config));
+}
+
+size_t BatchEnv::observation_bytes() const {
+    return observations.empty() ? 0 : observations[0].bytes();
+}
+
+/**
+ * @brief Renders every instance and writes their stacked observations into one contiguous buffer.
+ * 
+ * @param out The destination buffer, size()*observation_bytes() bytes.
+ */
+void BatchEnv::observe(uint8_t *out) {
+    assert(!observations.empty());
+    pool.parallel_for(envs.size(), [&](size_t i) {
+        observations[i].process(render_instance(i), out + i*observation_bytes());
+    });
+}
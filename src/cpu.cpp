@@ -0,0 +1,80 @@
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <iostream>
+
+#include "../include/headers/cpu.h"
+
+static const char *level_names[] = { "generic", "sse4.2", "avx2", "avx512" };
+
+/**
+ * @brief Detects the best instruction set available.
+ * 
+ * @return The highest level that the processor supports and that has kernels in this build.
+ */
+CpuLevel cpu_detect() {
+#ifdef CPU_DISPATCH
+    __builtin_cpu_init();
+#ifdef CPU_DISPATCH_AVX
+    if (__builtin_cpu_supports("avx512f")) return CpuLevel::AVX512;
+    if (__builtin_cpu_supports("avx2")) return CpuLevel::AVX2;
+#endif
+    if (__builtin_cpu_supports("sse4.2")) return CpuLevel::SSE42;
+#endif
+    return CpuLevel::GENERIC;
+}
+
+const char *cpu_level_name(const CpuLevel level) {
+    return level_names[static_cast<int>(level)];
+}
+
+bool parse_cpu_level(const char *name, CpuLevel &level) {
+    for (int i = 0; i < 4; i++) {
+        if (!std::strcmp(name, level_names[i])) {
+            level = static_cast<CpuLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Returns the level selected at the first call: the detected one, or DOOM_CPU if set and supported.
+ */
+static CpuLevel initial_level() {
+    const CpuLevel detected = cpu_detect();
+    const char *env = std::getenv("DOOM_CPU");
+    if (!env) return detected;
+
+    CpuLevel forced;
+    if (!parse_cpu_level(env, forced)) {
+        std::cerr << "Unknown DOOM_CPU level " << env << ", expected generic, sse4.2, avx2 or avx512" << std::endl;
+        return detected;
+    }
+    if (forced > detected) {
+        std::cerr << "DOOM_CPU=" << env << " is not supported here, using " << cpu_level_name(detected) << std::endl;
+        return detected;
+    }
+    return forced;
+}
+
+static std::atomic<CpuLevel> &current_level() {
+    static std::atomic<CpuLevel> level(initial_level());
+    return level;
+}
+
+CpuLevel cpu_level() {
+    return current_level().load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Forces the level of the kernels, e.g. to compare two of them on the same machine.
+ * 
+ * @param level The level to use.
+ * @return false, leaving the level unchanged, if the processor or the build do not support it.
+ */
+bool set_cpu_level(const CpuLevel level) {
+    if (level > cpu_detect()) return false;
+    current_level().store(level, std::memory_order_relaxed);
+    return true;
+}
@@ -112,9 +112,84 @@ void FrameBuffer::draw_text(SDL_Renderer* renderer, const std::string &text, con
  * @brief Clears the framebuffer with a specified color.
  * 
  * This function fills the entire framebuffer with the specified color.
+ * The storage is reused once it is large enough, so the pixels pointer stays valid
+ * from one frame to the next.
  * 
  * @param color The color to fill the framebuffer with, represented as a 32-bit unsigned integer.
  */
 void FrameBuffer::clear(const uint32_t color) {
-    img = std::vector<uint32_t>(w*h, color);
+    img.assign(w*h, color);
+}
+
+/**
+ * @brief Allocates (or releases) the per-pixel depth and label buffers.
+ * 
+ * render() fills the allocated buffers in the same passes that draw the pixels.
+ * 
+ * @param with_depth Whether the depth buffer is wanted.
+ * @param with_labels Whether the semantic label buffer is wanted.
+ */
+void FrameBuffer::enable_aux(const bool with_depth, const bool with_labels) {
+    depth.assign(with_depth ? w*h : 0, 0.f);
+    labels.assign(with_labels ? w*h : 0, 0);
+}
+
+bool FrameBuffer::has_aux() const {
+    return !depth.empty() || !labels.empty();
+}
+
+/**
+ * @brief Allocates (or releases) the set of the map cells seen in the 3D view.
+ * 
+ * render() marks every cell the rays of the walls cross, up to and including the wall they hit,
+ * so the set holds the cells in view for the frame: other systems (automap, interest management,
+ * AI) can query it with cell_visible() instead of casting their own rays. The dimensions must be
+ * those of the map rendered, the set is left empty otherwise.
+ * 
+ * @param map_w The width of the map.
+ * @param map_h The height of the map.
+ */
+void FrameBuffer::enable_visible_cells(const size_t map_w, const size_t map_h) {
+    visible_w = map_w;
+    visible_h = map_h;
+    visible_cells.assign((map_w * map_h + 63) / 64, 0);
+}
+
+bool FrameBuffer::cell_visible(const size_t i, const size_t j) const {
+    if (i >= visible_w || j >= visible_h) return false;
+    const size_t bit = i + j * visible_w;
+    return visible_cells[bit / 64] >> (bit % 64) & 1;
+}
+
+size_t FrameBuffer::visible_cell_count() const {
+    size_t count = 0;
+    for (const uint64_t word : visible_cells) count += __builtin_popcountll(word);
+    return count;
+}
+
+/**
+ * @brief Allocates (or releases) the wall hits of the rays of the columns.
+ * 
+ * The 3D view of render() writes where the ray of every column hits, so that other systems
+ * (crosshair target, door prompt, debugging overlays) can read it after the frame instead of
+ * casting the rays again.
+ * 
+ * @param enabled Whether the hits are wanted.
+ */
+void FrameBuffer::enable_ray_hits(const bool enabled) {
+    ray_hits.assign(enabled ? w : 0, RayHit{ 0, 0, -1, 0.f, 0.f, 0.f, 0.f, -1, 0 });
+}
+
+/**
+ * @brief Sets the depth and the semantic label of a pixel, in the buffers that are allocated.
+ * 
+ * @param x The x-coordinate of the pixel.
+ * @param y The y-coordinate of the pixel.
+ * @param z The distance from the player of what the pixel shows.
+ * @param label The semantic label of what the pixel shows.
+ */
+void FrameBuffer::set_aux(const size_t x, const size_t y, const float z, const uint16_t label) {
+    assert(x<w && y<h);
+    if (!depth.empty()) depth[x+y*w] = z;
+    if (!labels.empty()) labels[x+y*w] = label;
 }
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include <iostream>
+#include <cassert>
+#include <atomic>
+
+#include "../include/headers/framegraph.h"
+#include "../include/headers/threadpool.h"
+#include "../include/headers/arena.h"
+#include "../include/headers/alloctrack.h"
+
+/**
+ * @brief State of one execute() on a pool.
+ *
+ * It lives on the stack of the thread calling execute(), so frames rendered at the same time
+ * with the same graph (e.g. by the workers of a BatchEnv) do not share anything.
+ */
+struct FrameGraph::Execution {
+    const FrameGraph &graph;
+    RenderFrame &frame;
+    ThreadPool &pool;
+    uint32_t successors[max_passes];              // passes waiting for each pass
+    std::atomic<uint32_t> remaining[max_passes];  // predecessors of each pass not finished yet
+    JobCounter done;
+
+    void submit(const size_t index) {
+        pool.submit(Job{ run_pass, this, index, index + 1, &done });
+    }
+};
+
+/**
+ * @brief Appends a pass to the graph.
+ *
+ * A pass is ordered after every earlier pass it conflicts with: one of them writes a resource
+ * the other reads or writes. Passes without conflicts may run at the same time.
+ *
+ * @param name The name of the pass, used to enable or disable it.
+ * @param reads The RenderResource mask of the resources the pass reads.
+ * @param writes The RenderResource mask of the resources the pass writes.
+ * @param fills The part of writes overwritten entirely, so that earlier writes not read in between can be skipped.
+ * @param run The function drawing the pass.
+ */
+void FrameGraph::add(const std::string &name, const uint32_t reads, const uint32_t writes, const uint32_t fills, RenderPass run) {
+    assert(run && (fills & ~writes) == 0);
+    if (passes.size() == max_passes) {
+        std::cerr << "Too many passes in the frame graph, " << name << " is ignored" << std::endl;
+        return;
+    }
+    passes.push_back(Pass{ name, reads, writes, fills, run, true });
+}
+
+bool FrameGraph::set_enabled(const std::string &name, const bool enabled) {
+    for (auto &pass : passes) {
+        if (pass.name != name) continue;
+        pass.enabled = enabled;
+        return true;
+    }
+    return false;
+}
+
+bool FrameGraph::enabled(const std::string &name) const {
+    for (const auto &pass : passes)
+        if (pass.name == name) return pass.enabled;
+    return false;
+}
+
+size_t FrameGraph::size() const {
+    return passes.size();
+}
+
+/**
+ * @brief Finds the passes worth running.
+ *
+ * A pass is skipped when it is disabled, or when everything it writes is filled by a later
+ * pass before any pass reads it (e.g. clearing the screen before a 3D view covering it).
+ *
+ * @return The mask of the passes to run.
+ */
+uint32_t FrameGraph::live_passes() const {
+    uint32_t live = 0;
+    for (size_t i = passes.size(); i-- > 0;) {
+        const Pass &pass = passes[i];
+        if (!pass.enabled) continue;
+        bool overwritten = false;
+        for (size_t k = i + 1; k < passes.size() && pass.writes && !overwritten; k++) {
+            if (!(live >> k & 1)) continue;
+            if (passes[k].reads & pass.writes) break;
+            overwritten = (passes[k].fills & pass.writes) == pass.writes;
+        }
+        if (!overwritten) live |= 1u << i;
+    }
+    return live;
+}
+
+/**
+ * @brief Runs one pass on the calling thread.
+ *
+ * The temporaries of the pass come from the FrameArena of the thread running it, which may be
+ * a worker of the pool, and are released when it returns: what outlives a pass is in the frame.
+ */
+void FrameGraph::run(const size_t index, RenderFrame &frame) const {
+    ArenaScope pass_memory(FrameArena::local());
+    passes[index].run(frame);
+}
+
+/**
+ * @brief Job running one pass, then queuing the passes it was the last predecessor of.
+ *
+ * The successors are queued before the job is counted as done, so the counter of the
+ * execution only reaches 0 once every pass has run. The pass and its own loops are charged
+ * to ALLOC_RENDER, as the passes run by render() without a pool.
+ */
+void FrameGraph::run_pass(void *data, size_t index, size_t) {
+    AllocScope scope(ALLOC_RENDER);
+    Execution &execution = *static_cast<Execution *>(data);
+    execution.graph.run(index, execution.frame);
+    for (uint32_t next = execution.successors[index]; next; next &= next - 1) {
+        const size_t k = __builtin_ctz(next);
+        if (execution.remaining[k].fetch_sub(1) == 1) execution.submit(k);
+    }
+}
+
+/**
+ * @brief Runs the passes of the graph for one frame.
+ *
+ * Without a pool the passes run in declaration order on the calling thread. With a pool every
+ * pass becomes a job queued once its predecessors are done, and the calling thread runs jobs
+ * until the frame is complete: e.g. the minimap is drawn while the walls are cast. Nothing is
+ * allocated, so frames can be rendered in the zero-allocation mode.
+ *
+ * @param frame The frame the passes draw.
+ * @param pool The pool running the passes, or nullptr.
+ */
+void FrameGraph::execute(RenderFrame &frame, ThreadPool *pool) const {
+    const uint32_t live = live_passes();
+
+    if (!pool) {
+        for (size_t i = 0; i < passes.size(); i++)
+            if (live >> i & 1) run(i, frame);
+        return;
+    }
+
+    Execution execution{ *this, frame, *pool, {}, {}, {} };
+    uint32_t predecessors[max_passes] = {};
+    for (size_t i = 0; i < passes.size(); i++) {
+        if (!(live >> i & 1)) continue;
+        for (size_t j = 0; j < i; j++) {
+            if (!(live >> j & 1)) continue;
+            const Pass &a = passes[j], &b = passes[i];
+            if ((a.writes & (b.reads | b.writes)) || (a.reads & b.writes)) {
+                predecessors[i]++;
+                execution.successors[j] |= 1u << i;
+            }
+        }
+        execution.remaining[i] = predecessors[i];
+    }
+
+    for (size_t i = 0; i < passes.size(); i++)
+        if ((live >> i & 1) && !predecessors[i]) execution.submit(i);
+    pool->wait(execution.done);
+}
@@ -1,6 +1,7 @@
 #define SDL_MAIN_HANDLED
 
 #include <iostream>
+#include <cstdlib>
 #include <vector>
 #include <algorithm>
 #include <math.h>
@@ -16,6 +17,10 @@
 #include "../include/headers/tinyraycaster.h"
 #include "../include/headers/sprite.h"
 #include "../include/headers/player.h"
+#include "../include/headers/alloctrack.h"
+#include "../include/headers/cpu.h"
+#include "../include/headers/threadpool.h"
+#include "../include/headers/framegraph.h"
 
 /**
  * @file gui.cpp
@@ -33,9 +38,35 @@
  * - Enters the main game loop to handle events, update the game state, and render the game.
  * - Cleans up SDL resources before exiting.
  *
+ * The option --cpu=<generic|sse4.2|avx2|avx512> forces the instruction set of the render kernels
+ * (the same as the DOOM_CPU environment variable), to compare them on the same machine.
+ * The option --tiles draws the 3D view and the sprites tile by tile (see tiled_frame_graph),
+ * --lod draws the small sprites from pre-scaled images (see RenderSettings::sprite_lod), and
+ * --fog=<distance> hides everything farther than distance cells in the fog (see RenderSettings::draw_distance).
+ *
  * @return int Returns 0 on successful execution, or -1 on failure.
  */
-int main() {
+int main(int argc, char *argv[]) {
+    bool tiles = false;
+    RenderSettings settings;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        CpuLevel level;
+        if (arg == "--tiles") {
+            tiles = true;
+        } else if (arg == "--lod") {
+            settings.sprite_lod = true;
+        } else if (arg.rfind("--fog=", 0) == 0 && std::atof(arg.c_str() + 6) > 0) {
+            settings.draw_distance = std::atof(arg.c_str() + 6);
+        } else if (arg.rfind("--cpu=", 0) == 0 && parse_cpu_level(arg.c_str() + 6, level)) {
+            if (!set_cpu_level(level)) std::cerr << "The " << arg.substr(6) << " kernels are not supported on this processor" << std::endl;
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return -1;
+        }
+    }
+    std::cout << "Render kernels: " << cpu_level_name(cpu_level()) << std::endl;
+    const FrameGraph graph = tiles ? tiled_frame_graph() : standard_frame_graph();
 
     // Initialize SDL and create a window and renderer
     if (SDL_Init(SDL_INIT_VIDEO)) {
@@ -49,17 +80,10 @@ int main() {
         return -1;
     }
 
-    FrameBuffer fb{1200, 600, std::vector<uint32_t>(1024*512, pack_color(255, 255, 255))};
-
-    GameState gs{ Map(),                                // game map
-                  Player(2, 14, 270, M_PI/3.),          // player
-                  { {8, 14, 3, 0},                      // monsters lists
-                    {9, 14.50, 3, 0},
-                    {10, 13.50, 3, 0}, },
-                  Texture("texture/walltext.bmp", SDL_PIXELFORMAT_ABGR8888),          // textures for the walls
-                  Texture("texture/monsters.bmp", SDL_PIXELFORMAT_ABGR8888),          // textures for the monsters
-                  Texture("texture/pistolSprites.bmp", SDL_PIXELFORMAT_ABGR8888) };   // textures for the gun  
-    if (!gs.tex_walls.count || !gs.tex_monst.count) {
+    FrameBuffer fb{1200, 600, std::vector<uint32_t>(1200*600, pack_color(255, 255, 255))};
+
+    GameState gs = new_game("");
+    if (!gs.tex_walls->count || !gs.tex_monst->count) {
         std::cerr << "Failed to load textures" << std::endl;
         return -1;
     }
@@ -105,18 +129,16 @@ int main() {
         }
 
         // Update the game state
-        gs.player.update_position(gs.map); // Update the player's position
+        update(gs);
 
-        for (auto& monster : gs.monsters) { monster.update_position(gs.player, gs.map, 0.05f); } // Update the monsters' positions
-        
-        for (size_t i=0; i<gs.monsters.size(); i++) { // update the distances from the player to each sprite
-            gs.monsters[i].player_dist = std::sqrt(pow(gs.player.x - gs.monsters[i].x, 2) + pow(gs.player.y - gs.monsters[i].y, 2));
-        }
-        std::sort(gs.monsters.begin(), gs.monsters.end()); // sort it from farthest to closest
 
+        // Render the game state to the framebuffer, on all the cores
+        render(fb, gs, graph, &ThreadPool::shared(), settings);
 
-        // Render the game state to the framebuffer
-        render(fb, gs, renderer);
+        // Close the frame for the allocation tracking and print its counters about once per second
+        alloc_frame_end();
+        static size_t frame = 0;
+        if (alloc_tracking() && ++frame % 50 == 0) alloc_report(stderr, alloc_frame());
 
 
         // Copy the framebuffer contents to the screen
@@ -0,0 +1,170 @@
+#include <cassert>
+
+#include "../include/headers/kernels.h"
+
+#ifdef CPU_DISPATCH
+#include <immintrin.h>
+#endif
+
+// The floor kernels put one row per vector lane, so that the position of every pixel is the result of
+// the same sequence of float additions as in the portable loop and the pixels are bit-identical.
+// Every kernel reads the texels and shades them (each component halved) the same way.
+
+#ifdef CPU_DISPATCH
+
+/**
+ * @brief Draws the floor and the ceiling 4 rows at a time with SSE4.1/4.2.
+ */
+__attribute__((target("sse4.2")))
+static size_t floor_rows_sse42(const FloorRows &rows, const size_t count) {
+    const __m128 size = _mm_set1_ps(rows.size);
+    const __m128i mask = _mm_set1_epi32(rows.mask);
+    const __m128i stride = _mm_set1_epi32(static_cast<int>(rows.stride));
+    const __m128i shade = _mm_set1_epi32(8355711);
+
+    size_t r = 0;
+    for (; r + 4 <= count; r += 4) {
+        uint32_t *floor_row[4], *ceiling_row[4];
+        for (size_t k = 0; k < 4; k++) {
+            floor_row[k] = rows.img + (rows.top + r + k) * rows.w;
+            ceiling_row[k] = rows.img + (rows.h - 1 - rows.top - r - k) * rows.w;
+        }
+        __m128 fx = _mm_loadu_ps(rows.x + r), fy = _mm_loadu_ps(rows.y + r);
+        const __m128 sx = _mm_loadu_ps(rows.step_x + r), sy = _mm_loadu_ps(rows.step_y + r);
+
+        for (size_t x = rows.x0; x < rows.x1; x++) {
+            __m128 cx = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+            __m128 cy = _mm_cvtepi32_ps(_mm_cvttps_epi32(fy));
+            __m128i tx = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(size, _mm_sub_ps(fx, cx))), mask);
+            __m128i ty = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(size, _mm_sub_ps(fy, cy))), mask);
+            __m128i idx = _mm_add_epi32(tx, _mm_mullo_epi32(ty, stride));
+            fx = _mm_add_ps(fx, sx);
+            fy = _mm_add_ps(fy, sy);
+
+            const int i0 = _mm_cvtsi128_si32(idx), i1 = _mm_extract_epi32(idx, 1), i2 = _mm_extract_epi32(idx, 2), i3 = _mm_extract_epi32(idx, 3);
+            __m128i f = _mm_setr_epi32(rows.floor[i0], rows.floor[i1], rows.floor[i2], rows.floor[i3]);
+            __m128i c = _mm_setr_epi32(rows.ceiling[i0], rows.ceiling[i1], rows.ceiling[i2], rows.ceiling[i3]);
+            f = _mm_and_si128(_mm_srli_epi32(f, 1), shade);
+            c = _mm_and_si128(_mm_srli_epi32(c, 1), shade);
+
+            floor_row[0][x] = _mm_cvtsi128_si32(f);   ceiling_row[0][x] = _mm_cvtsi128_si32(c);
+            floor_row[1][x] = _mm_extract_epi32(f, 1); ceiling_row[1][x] = _mm_extract_epi32(c, 1);
+            floor_row[2][x] = _mm_extract_epi32(f, 2); ceiling_row[2][x] = _mm_extract_epi32(c, 2);
+            floor_row[3][x] = _mm_extract_epi32(f, 3); ceiling_row[3][x] = _mm_extract_epi32(c, 3);
+        }
+    }
+    return r;
+}
+
+#ifdef CPU_DISPATCH_AVX
+
+/**
+ * @brief Draws the floor and the ceiling 8 rows at a time with AVX2, gathering the texels.
+ */
+__attribute__((target("avx2")))
+static size_t floor_rows_avx2(const FloorRows &rows, const size_t count) {
+    const __m256 size = _mm256_set1_ps(rows.size);
+    const __m256i mask = _mm256_set1_epi32(rows.mask);
+    const __m256i stride = _mm256_set1_epi32(static_cast<int>(rows.stride));
+    const __m256i shade = _mm256_set1_epi32(8355711);
+    const int *floor = reinterpret_cast<const int *>(rows.floor);
+    const int *ceiling = reinterpret_cast<const int *>(rows.ceiling);
+
+    size_t r = 0;
+    for (; r + 8 <= count; r += 8) {
+        uint32_t *floor_row[8], *ceiling_row[8];
+        for (size_t k = 0; k < 8; k++) {
+            floor_row[k] = rows.img + (rows.top + r + k) * rows.w;
+            ceiling_row[k] = rows.img + (rows.h - 1 - rows.top - r - k) * rows.w;
+        }
+        __m256 fx = _mm256_loadu_ps(rows.x + r), fy = _mm256_loadu_ps(rows.y + r);
+        const __m256 sx = _mm256_loadu_ps(rows.step_x + r), sy = _mm256_loadu_ps(rows.step_y + r);
+        alignas(32) uint32_t f[8], c[8];
+
+        for (size_t x = rows.x0; x < rows.x1; x++) {
+            __m256 cx = _mm256_cvtepi32_ps(_mm256_cvttps_epi32(fx));
+            __m256 cy = _mm256_cvtepi32_ps(_mm256_cvttps_epi32(fy));
+            __m256i tx = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(size, _mm256_sub_ps(fx, cx))), mask);
+            __m256i ty = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(size, _mm256_sub_ps(fy, cy))), mask);
+            __m256i idx = _mm256_add_epi32(tx, _mm256_mullo_epi32(ty, stride));
+            fx = _mm256_add_ps(fx, sx);
+            fy = _mm256_add_ps(fy, sy);
+
+            __m256i fv = _mm256_and_si256(_mm256_srli_epi32(_mm256_i32gather_epi32(floor, idx, 4), 1), shade);
+            __m256i cv = _mm256_and_si256(_mm256_srli_epi32(_mm256_i32gather_epi32(ceiling, idx, 4), 1), shade);
+            _mm256_store_si256(reinterpret_cast<__m256i *>(f), fv);
+            _mm256_store_si256(reinterpret_cast<__m256i *>(c), cv);
+            for (size_t k = 0; k < 8; k++) {
+                floor_row[k][x] = f[k];
+                ceiling_row[k][x] = c[k];
+            }
+        }
+    }
+    return r;
+}
+
+/**
+ * @brief Draws the floor and the ceiling 16 rows at a time with AVX-512, gathering the texels and scattering the pixels.
+ */
+__attribute__((target("avx512f")))
+static size_t floor_rows_avx512(const FloorRows &rows, const size_t count) {
+    const __m512 size = _mm512_set1_ps(rows.size);
+    const __m512i mask = _mm512_set1_epi32(rows.mask);
+    const __m512i stride = _mm512_set1_epi32(static_cast<int>(rows.stride));
+    const __m512i shade = _mm512_set1_epi32(8355711);
+    const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m512i width = _mm512_set1_epi32(static_cast<int>(rows.w));
+    assert(rows.w * rows.h <= 0x7FFFFFFF); // pixel offsets are scattered as 32 bit integers
+
+    size_t r = 0;
+    for (; r + 16 <= count; r += 16) {
+        // offsets of the pixel x0 of the floor and ceiling rows of each lane
+        const __m512i first = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(rows.top + r)), lanes);
+        const __m512i x0 = _mm512_set1_epi32(static_cast<int>(rows.x0));
+        __m512i floor_at = _mm512_add_epi32(_mm512_mullo_epi32(first, width), x0);
+        __m512i ceiling_at = _mm512_add_epi32(_mm512_mullo_epi32(_mm512_sub_epi32(_mm512_set1_epi32(static_cast<int>(rows.h - 1)), first), width), x0);
+        __m512 fx = _mm512_loadu_ps(rows.x + r), fy = _mm512_loadu_ps(rows.y + r);
+        const __m512 sx = _mm512_loadu_ps(rows.step_x + r), sy = _mm512_loadu_ps(rows.step_y + r);
+        const __m512i one = _mm512_set1_epi32(1);
+
+        for (size_t x = rows.x0; x < rows.x1; x++) {
+            __m512 cx = _mm512_cvtepi32_ps(_mm512_cvttps_epi32(fx));
+            __m512 cy = _mm512_cvtepi32_ps(_mm512_cvttps_epi32(fy));
+            __m512i tx = _mm512_and_si512(_mm512_cvttps_epi32(_mm512_mul_ps(size, _mm512_sub_ps(fx, cx))), mask);
+            __m512i ty = _mm512_and_si512(_mm512_cvttps_epi32(_mm512_mul_ps(size, _mm512_sub_ps(fy, cy))), mask);
+            __m512i idx = _mm512_add_epi32(tx, _mm512_mullo_epi32(ty, stride));
+            fx = _mm512_add_ps(fx, sx);
+            fy = _mm512_add_ps(fy, sy);
+
+            __m512i fv = _mm512_and_si512(_mm512_srli_epi32(_mm512_i32gather_epi32(idx, rows.floor, 4), 1), shade);
+            __m512i cv = _mm512_and_si512(_mm512_srli_epi32(_mm512_i32gather_epi32(idx, rows.ceiling, 4), 1), shade);
+            _mm512_i32scatter_epi32(rows.img, floor_at, fv, 4); // the floor first, as the portable loop (on odd heights the
+            _mm512_i32scatter_epi32(rows.img, ceiling_at, cv, 4); // middle row is both and the ceiling must win)
+            floor_at = _mm512_add_epi32(floor_at, one);
+            ceiling_at = _mm512_add_epi32(ceiling_at, one);
+        }
+    }
+    return r;
+}
+
+#endif // CPU_DISPATCH_AVX
+#endif // CPU_DISPATCH
+
+/**
+ * @brief Returns the floor kernel built for the given instruction set.
+ * 
+ * @param level The instruction set, usually cpu_level().
+ * @return The kernel, or nullptr when the portable loop should be used.
+ */
+FloorKernel floor_kernel(const CpuLevel level) {
+    switch (level) {
+#ifdef CPU_DISPATCH
+#ifdef CPU_DISPATCH_AVX
+        case CpuLevel::AVX512: return floor_rows_avx512;
+        case CpuLevel::AVX2:   return floor_rows_avx2;
+#endif
+        case CpuLevel::SSE42:  return floor_rows_sse42;
+#endif
+        default:               return nullptr;
+    }
+}
@@ -1,9 +1,12 @@
 #include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
 
 #include "../include/headers/map.h"
 
 
-static char map[] = "1111111111111111"\
+static const char level[] = "1111111111111111"\
                     "1              1"\
                     "1     1111131111"\
                     "1     1    9   1"\
@@ -20,18 +23,124 @@ static char map[] = "1111111111111111"\
                     "1              1"\
                     "1111111111111111"; // our game map [1 is a wall, 3 is a door]
 
+/**
+ * @brief Splits a layout into the chunks shared by all the maps built from it.
+ *
+ * @param layout The map cells, row by row.
+ * @param cells The number of cells in the layout.
+ * @return The chunk list; the last chunk is padded with walls.
+ */
+static std::shared_ptr<const std::vector<std::shared_ptr<Map::Chunk>>> make_base(const char *layout, const size_t cells) {
+    auto base = std::make_shared<std::vector<std::shared_ptr<Map::Chunk>>>();
+    for (size_t k = 0; k < cells; k += Map::chunk_size) {
+        auto chunk = std::make_shared<Map::Chunk>();
+        std::memset(chunk->cells, '1', Map::chunk_size);
+        std::memcpy(chunk->cells, layout + k, std::min(Map::chunk_size, cells - k));
+        base->push_back(chunk);
+    }
+    return base;
+}
+
+/**
+ * @brief Builds the default level.
+ *
+ * The base layout is created once and shared by every default map, each map copies
+ * only the chunks it modifies.
+ */
 Map::Map() : w(16), h(16) {
-    assert(sizeof(map) == w*h+1); // +1 for the null terminated string
+    assert(sizeof(level) == w*h+1); // +1 for the null terminated string
+    static const auto default_base = make_base(level, w*h);
+    base = default_base;
+    chunks = *base;
+}
+
+/**
+ * @brief Builds a map from a custom layout.
+ *
+ * Copies of this map share the layout, like the default maps share the default level.
+ *
+ * @param w The width of the map.
+ * @param h The height of the map.
+ * @param layout The map cells, row by row [' ' is empty, 1 is a wall, 3 is a door, 9 is in front of a door].
+ */
+Map::Map(const size_t w, const size_t h, const std::string &layout) : w(w), h(h), base(make_base(layout.c_str(), w*h)), chunks(*base) {
+    assert(layout.size() == w*h);
+}
+
+char Map::cell(const size_t i, const size_t j) const {
+    const size_t k = i+j*w;
+    return chunks[k / chunk_size]->cells[k % chunk_size];
+}
+
+/**
+ * @brief Modifies one cell, copying its chunk first if it is shared.
+ *
+ * A chunk is shared with the base layout (or with copies of this map) as long as its
+ * reference count is greater than one.
+ */
+void Map::set(const size_t i, const size_t j, const char c) {
+    const size_t k = i+j*w;
+    std::shared_ptr<Chunk> &chunk = chunks[k / chunk_size];
+    if (chunk.use_count() > 1) {
+        chunk = std::make_shared<Chunk>(*chunk);
+    }
+    chunk->cells[k % chunk_size] = c;
+}
+
+void Map::reset() {
+    for (size_t c = 0; c < chunks.size(); c++) { // only the private chunks need to be dropped
+        if (chunks[c] != (*base)[c]) chunks[c] = (*base)[c];
+    }
+}
+
+size_t Map::private_chunks() const {
+    size_t count = 0;
+    for (size_t c = 0; c < chunks.size(); c++) {
+        if (chunks[c] != (*base)[c]) count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Lists the cells that differ from the base layout.
+ *
+ * Only the private chunks are compared, the shared ones are identical to the base by construction.
+ *
+ * @param out The vector the (cell index, value) pairs are appended to.
+ */
+void Map::modified_cells(std::vector<std::pair<uint32_t, char>> &out) const {
+    for (size_t c = 0; c < chunks.size(); c++) {
+        if (chunks[c] == (*base)[c]) continue;
+        for (size_t k = 0; k < chunk_size && c*chunk_size + k < w*h; k++) {
+            if (chunks[c]->cells[k] != (*base)[c]->cells[k]) {
+                out.emplace_back(static_cast<uint32_t>(c*chunk_size + k), chunks[c]->cells[k]);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Resets the map to the base layout and applies a list of modified cells.
+ *
+ * @param cells The (cell index, value) pairs, as listed by modified_cells.
+ * @param count The number of pairs.
+ */
+void Map::restore(const std::pair<uint32_t, char> *cells, const size_t count) {
+    reset();
+    for (size_t n = 0; n < count; n++) {
+        assert(cells[n].first < w*h);
+        set(cells[n].first % w, cells[n].first / w, cells[n].second);
+    }
 }
 
 int Map::get(const size_t i, const size_t j) const {
-    //assert(i<w && j<h && sizeof(map) == w*h+1);
-    return map[i+j*w] - '0';
+    //assert(i<w && j<h);
+    return cell(i, j) - '0';
 }
 
 bool Map::is_empty(const size_t i, const size_t j) const {
-    assert(i<w && j<h && sizeof(map) == w*h+1);
-    return map[i+j*w] == ' ' || map[i+j*w] == '9';
+    assert(i<w && j<h);
+    return cell(i, j) == ' ' || cell(i, j) == '9';
 }
 
 /**
@@ -59,8 +168,48 @@ std::pair<int, int> Map::check_door(const size_t i, const size_t j) const{
 }
 
 void Map::open_door(const size_t i, const size_t j) {
-    assert(i<w && j<h && sizeof(map) == w*h+1);
-    if (map[i+j*w] == '3') {
-        map[i+j*w] = ' ';
+    assert(i<w && j<h);
+    if (cell(i, j) == '3') {
+        set(i, j, ' ');
+    }
+}
+
+/**
+ * @brief Checks whether two points see each other.
+ *
+ * The cells crossed by the segment are walked with the same Digital Differential Analysis
+ * used to cast the rays in render(); the segment is blocked by the first non empty cell.
+ *
+ * @param x0 The x-coordinate of the first point.
+ * @param y0 The y-coordinate of the first point.
+ * @param x1 The x-coordinate of the second point.
+ * @param y1 The y-coordinate of the second point.
+ * @return true if nothing blocks the segment.
+ */
+bool Map::line_of_sight(const float x0, const float y0, const float x1, const float y1) const {
+    int map_x = int(x0), map_y = int(y0);
+    const int end_x = int(x1), end_y = int(y1);
+    const float dir_x = x1 - x0, dir_y = y1 - y0;
+
+    const int step_x = dir_x < 0 ? -1 : 1;
+    const int step_y = dir_y < 0 ? -1 : 1;
+    const float delta_x = dir_x == 0 ? 1e30f : std::abs(1 / dir_x); // segment fraction between two x-sides
+    const float delta_y = dir_y == 0 ? 1e30f : std::abs(1 / dir_y); // segment fraction between two y-sides
+    float side_x = (dir_x < 0 ? x0 - map_x : map_x + 1 - x0) * delta_x;
+    float side_y = (dir_y < 0 ? y0 - map_y : map_y + 1 - y0) * delta_y;
+
+    while (map_x != end_x || map_y != end_y) {
+        if (side_x < side_y) {
+            if (side_x > 1) break; // the rest of the segment stays in the last cell
+            side_x += delta_x;
+            map_x += step_x;
+        } else {
+            if (side_y > 1) break;
+            side_y += delta_y;
+            map_y += step_y;
+        }
+        if (map_x < 0 || map_y < 0 || map_x >= int(w) || map_y >= int(h)) return false;
+        if (!is_empty(map_x, map_y)) return false;
     }
+    return true;
 }
\ No newline at end of file
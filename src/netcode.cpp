@@ -0,0 +1,384 @@
+#include <cassert>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#include "../include/headers/netcode.h"
+#include "../include/headers/alloctrack.h"
+
+static constexpr uint8_t packet_inputs = 1; // [type][sender][ack u32][first tick u32][count u16][count inputs]
+static constexpr uint8_t packet_report = 2; // [type][sender][tick u32][players u16][monsters u16][(id u32, x float, y float)...]
+static constexpr float sight_distance = 15; // same as the sprite draw distance in render()
+static constexpr uint32_t no_rollback = std::numeric_limits<uint32_t>::max();
+
+template <typename T> static void put(std::vector<uint8_t> &packet, const T &value) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+    packet.insert(packet.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T> static bool get(const std::vector<uint8_t> &packet, size_t &offset, T &value) {
+    if (offset + sizeof(T) > packet.size()) return false;
+    std::memcpy(&value, packet.data() + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+/**
+ * @brief Advances a multiplayer game by one tick.
+ * 
+ * Only the inputs and the previous state are used, so every peer simulating the same inputs
+ * gets the same state. Ties between players at the same distance from a monster go to the
+ * lowest index, for the same reason.
+ * 
+ * @param state The game to advance.
+ * @param inputs One input per player.
+ */
+void simulate(NetState &state, const Action *inputs) {
+    GameState &world = state.world;
+    for (size_t p = 0; p < state.players.size(); p++) {
+        state.players[p].apply_action(inputs[p], world.map, world.monsters);
+        state.players[p].update_position(world.map);
+    }
+
+    for (auto &monster : world.monsters) {
+        size_t closest = 0;
+        float closest_dist = std::numeric_limits<float>::max();
+        for (size_t p = 0; p < state.players.size(); p++) {
+            float dx = state.players[p].x - monster.x;
+            float dy = state.players[p].y - monster.y;
+            if (dx * dx + dy * dy < closest_dist) {
+                closest_dist = dx * dx + dy * dy;
+                closest = p;
+            }
+        }
+        if (!state.players.empty()) monster.update_position(state.players[closest], world.map, 0.05f);
+    }
+
+    world.tick++;
+}
+
+/**
+ * @brief Lists the entities a player can see.
+ * 
+ * This is the interest management of the session: consistency reports sent to a peer only
+ * contain the entities its player can see.
+ * 
+ * @param state The game.
+ * @param viewer The index of the player looking.
+ * @param players Filled with the indices of the other visible players.
+ * @param monsters Filled with the indices of the visible monsters.
+ */
+void visible_entities(const NetState &state, const size_t viewer, std::vector<uint32_t> &players, std::vector<uint32_t> &monsters) {
+    players.clear();
+    monsters.clear();
+    const Player &v = state.players[viewer];
+    auto visible = [&](const float x, const float y) {
+        float dx = x - v.x, dy = y - v.y;
+        return dx * dx + dy * dy < sight_distance * sight_distance && state.world.map.line_of_sight(v.x, v.y, x, y);
+    };
+    for (size_t p = 0; p < state.players.size(); p++) {
+        if (p != viewer && visible(state.players[p].x, state.players[p].y)) players.push_back(p);
+    }
+    for (size_t m = 0; m < state.world.monsters.size(); m++) {
+        if (visible(state.world.monsters[m].x, state.world.monsters[m].y)) monsters.push_back(m);
+    }
+}
+
+/**
+ * @brief Creates the session of one peer.
+ * 
+ * Transport peer i must be the peer of player i. Every player starts where the player of the
+ * initial state is. The first input_delay ticks have no input, on every peer.
+ * 
+ * @param initial The state of the game at tick 0.
+ * @param players The number of players.
+ * @param local The index of the player of this peer.
+ * @param transport The channel to the other peers.
+ * @param config The rollback window, the input delay and the report interval.
+ */
+RollbackSession::RollbackSession(const GameState &initial, const size_t players, const size_t local, Transport &transport, const RollbackConfig &config) :
+    cfg(config), local(local), transport(transport), current{initial, std::vector<Player>(players, initial.player)}, scratch(current), view_state(initial),
+    snapshots(config.window), inputs(config.window * players), known(config.window * players, 0), last_input(players, encode_action(Action{0, 0, false, false})),
+    received(players, 0), acked(players, 0), now(0), confirmed(0), rollback_from(no_rollback), rollback_count(0), resimulated(0), desync_count(0),
+    tick_inputs(players) {
+    assert(local < players && cfg.input_delay < cfg.window && cfg.sync_interval > 0);
+    for (uint32_t t = 0; t < cfg.input_delay; t++) {
+        for (size_t p = 0; p < players; p++) set_input(t, p, last_input[p]);
+    }
+    std::fill(acked.begin(), acked.end(), static_cast<uint32_t>(cfg.input_delay));
+}
+
+size_t RollbackSession::players() const {
+    return current.players.size();
+}
+
+uint8_t &RollbackSession::input_slot(const uint32_t t, const size_t p) {
+    return inputs[(t % cfg.window) * players() + p];
+}
+
+uint8_t &RollbackSession::known_slot(const uint32_t t, const size_t p) {
+    return known[(t % cfg.window) * players() + p];
+}
+
+/**
+ * @brief Records the input of a player for a tick.
+ * 
+ * If the tick was already simulated with a different predicted input, the game will be
+ * rolled back to it.
+ */
+void RollbackSession::set_input(const uint32_t t, const size_t p, const uint8_t input) {
+    if (t < confirmed || t >= confirmed + cfg.window || known_slot(t, p)) return; // duplicate, or too far ahead to be stored
+    if (t < now && input_slot(t, p) != input) rollback_from = std::min(rollback_from, t);
+    input_slot(t, p) = input;
+    known_slot(t, p) = 1;
+    while (received[p] < confirmed + cfg.window && known_slot(received[p], p)) {
+        last_input[p] = input_slot(received[p], p);
+        received[p]++;
+    }
+}
+
+/**
+ * @brief Saves the state at the start of tick t and simulates it, predicting the missing inputs.
+ * 
+ * The prediction is the last input received from the player, i.e. the player keeps doing
+ * what it was doing.
+ */
+void RollbackSession::simulate_tick(const uint32_t t) {
+    snapshots[t % cfg.window].save(current.world, current.players);
+    for (size_t p = 0; p < players(); p++) {
+        if (!known_slot(t, p)) input_slot(t, p) = last_input[p];
+        tick_inputs[p] = decode_action(input_slot(t, p));
+    }
+    simulate(current, tick_inputs.data());
+}
+
+void RollbackSession::rollback() {
+    const uint32_t from = rollback_from;
+    rollback_from = no_rollback;
+    assert(from >= confirmed && from < now);
+    snapshots[from % cfg.window].restore(current.world, current.players);
+    for (uint32_t t = from; t < now; t++) {
+        simulate_tick(t);
+    }
+    rollback_count++;
+    resimulated += now - from;
+}
+
+/**
+ * @brief Moves the confirmed tick past the ticks whose inputs are all known.
+ * 
+ * Their ring slots are released for the ticks window ticks later, and a consistency report
+ * is sent every sync_interval confirmed ticks.
+ */
+void RollbackSession::advance_confirmed() {
+    while (confirmed < now) {
+        for (size_t p = 0; p < players(); p++) {
+            if (!known_slot(confirmed, p)) return;
+        }
+        for (size_t p = 0; p < players(); p++) known_slot(confirmed, p) = 0;
+        confirmed++;
+        if (confirmed % cfg.sync_interval == 0) send_report(confirmed);
+    }
+}
+
+/**
+ * @brief Sends to every peer the local inputs it has not acknowledged yet.
+ * 
+ * Inputs are resent until acknowledged, so lost packets only delay them.
+ */
+void RollbackSession::send_inputs() {
+    for (size_t q = 0; q < players(); q++) {
+        if (q == local) continue;
+        const uint32_t first = std::max(acked[q], confirmed);
+        const uint16_t count = static_cast<uint16_t>(std::min<uint32_t>(received[local] - std::min(first, received[local]), cfg.window));
+        packet.clear();
+        put(packet, packet_inputs);
+        put(packet, static_cast<uint8_t>(local));
+        put(packet, received[q]);
+        put(packet, first);
+        put(packet, count);
+        for (uint32_t t = first; t < first + count; t++) {
+            packet.push_back(input_slot(t, local));
+        }
+        transport.send(q, packet.data(), packet.size());
+    }
+}
+
+/**
+ * @brief Sends to every peer the positions of the entities its player sees at the start of tick t.
+ */
+void RollbackSession::send_report(const uint32_t t) {
+    const NetState *state = &current;
+    if (t < now) {
+        snapshots[t % cfg.window].restore(scratch.world, scratch.players);
+        state = &scratch;
+    }
+    for (size_t q = 0; q < players(); q++) {
+        if (q == local) continue;
+        visible_entities(*state, q, seen_players, seen_monsters);
+        packet.clear();
+        put(packet, packet_report);
+        put(packet, static_cast<uint8_t>(local));
+        put(packet, t);
+        put(packet, static_cast<uint16_t>(seen_players.size()));
+        put(packet, static_cast<uint16_t>(seen_monsters.size()));
+        for (uint32_t p : seen_players) {
+            put(packet, p); put(packet, state->players[p].x); put(packet, state->players[p].y);
+        }
+        for (uint32_t m : seen_monsters) {
+            put(packet, m); put(packet, state->world.monsters[m].x); put(packet, state->world.monsters[m].y);
+        }
+        transport.send(q, packet.data(), packet.size());
+    }
+}
+
+/**
+ * @brief Compares the reports received from the peers with the local confirmed states.
+ * 
+ * A report can be checked once its tick is confirmed locally, as long as the snapshot of
+ * that tick is still in the ring. Any difference means the peers diverged.
+ */
+void RollbackSession::check_reports() {
+    for (auto it = reports.begin(); it != reports.end(); ) {
+        const uint32_t t = it->tick;
+        if (t + cfg.window <= now) { // too old, the snapshot is gone
+            it = reports.erase(it);
+            continue;
+        }
+        if (t > confirmed) {
+            ++it;
+            continue;
+        }
+        const NetState *state = &current;
+        if (t < now) {
+            snapshots[t % cfg.window].restore(scratch.world, scratch.players);
+            state = &scratch;
+        }
+        size_t offset = 0;
+        uint16_t player_count = 0, monster_count = 0;
+        get(it->data, offset, player_count);
+        get(it->data, offset, monster_count);
+        for (size_t n = 0; n < size_t(player_count) + monster_count; n++) {
+            uint32_t id; float x, y;
+            if (!get(it->data, offset, id) || !get(it->data, offset, x) || !get(it->data, offset, y)) break;
+            bool is_player = n < player_count;
+            if (is_player ? id >= state->players.size() : id >= state->world.monsters.size()) {
+                desync_count++;
+                continue;
+            }
+            float sx = is_player ? state->players[id].x : state->world.monsters[id].x;
+            float sy = is_player ? state->players[id].y : state->world.monsters[id].y;
+            if (sx != x || sy != y) desync_count++;
+        }
+        it = reports.erase(it);
+    }
+}
+
+void RollbackSession::handle_packet(const size_t peer) {
+    size_t offset = 0;
+    uint8_t type = 0, sender = 0;
+    if (!get(packet, offset, type) || !get(packet, offset, sender) || sender >= players() || sender == local) return;
+    (void)peer;
+
+    if (type == packet_inputs) {
+        uint32_t ack = 0, first = 0;
+        uint16_t count = 0;
+        if (!get(packet, offset, ack) || !get(packet, offset, first) || !get(packet, offset, count)) return;
+        if (offset + count > packet.size()) return;
+        acked[sender] = std::max(acked[sender], ack);
+        for (uint16_t n = 0; n < count; n++) {
+            set_input(first + n, sender, packet[offset + n]);
+        }
+    } else if (type == packet_report) {
+        uint32_t t = 0;
+        if (!get(packet, offset, t)) return;
+        reports.push_back(Report{t, std::vector<uint8_t>(packet.begin() + offset, packet.end())});
+    }
+}
+
+void RollbackSession::poll() {
+    size_t peer = 0;
+    while (transport.receive(peer, packet)) {
+        handle_packet(peer);
+    }
+    if (rollback_from != no_rollback) rollback();
+    advance_confirmed();
+    check_reports();
+}
+
+/**
+ * @brief Simulates the next tick.
+ * 
+ * The local input is scheduled input_delay ticks ahead and sent to the peers. If a peer is
+ * so late that the rollback window would be exceeded, the tick is not simulated and the
+ * caller should try again later (the local inputs are sent anyway).
+ * 
+ * @param input The input of the local player.
+ * @return true if the tick was simulated.
+ */
+bool RollbackSession::advance(const Action &input) {
+    AllocScope scope(ALLOC_NETWORK);
+    poll();
+    if (now + cfg.input_delay >= confirmed + cfg.window) {
+        send_inputs();
+        return false;
+    }
+    set_input(now + cfg.input_delay, local, encode_action(input));
+    simulate_tick(now);
+    now++;
+    advance_confirmed();
+    send_inputs();
+    return true;
+}
+
+const NetState &RollbackSession::state() const {
+    return current;
+}
+
+/**
+ * @brief Returns the world seen by the local player, with the monsters sorted for render().
+ */
+const GameState &RollbackSession::view() {
+    view_state = current.world;
+    view_state.player = current.players[local];
+    sort_monsters(view_state);
+    return view_state;
+}
+
+/**
+ * @brief Saves the state at the start of the confirmed tick, simulated with the inputs of all the players.
+ * 
+ * Unlike state(), it holds no prediction, so every peer of a session saves the same state for
+ * the same confirmed tick: comparing them checks that the peers did not diverge.
+ * 
+ * @param out The snapshot receiving the state.
+ */
+void RollbackSession::save_confirmed(Snapshot &out) {
+    if (confirmed == now) {
+        out.save(current.world, current.players);
+        return;
+    }
+    snapshots[confirmed % cfg.window].restore(scratch.world, scratch.players);
+    out.save(scratch.world, scratch.players);
+}
+
+uint32_t RollbackSession::tick() const {
+    return now;
+}
+
+uint32_t RollbackSession::confirmed_tick() const {
+    return confirmed;
+}
+
+size_t RollbackSession::rollbacks() const {
+    return rollback_count;
+}
+
+size_t RollbackSession::resimulated_ticks() const {
+    return resimulated;
+}
+
+size_t RollbackSession::desyncs() const {
+    return desync_count;
+}
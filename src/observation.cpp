@@ -0,0 +1,278 @@
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "../include/headers/observation.h"
+#include "../include/headers/utils.h"
+#include "../include/headers/alloctrack.h"
+#include "../include/headers/cpu.h"
+
+#ifdef CPU_DISPATCH_AVX
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Sums a block of consecutive source rows, channel by channel.
+ * 
+ * With SSE2 the sums of 16 channels (4 pixels) are kept in registers while walking down
+ * the rows, so every source byte is read exactly once. They are 16 bit sums of at most 257
+ * rows, added to 32 bit sums after every such chunk, so any number of rows can be summed.
+ * 
+ * @param src The first pixel of the first row to sum.
+ * @param src_w The width of the source rows (and the distance between two of them) in pixels.
+ * @param count The number of rows to sum.
+ * @param sums The destination, 4*src_w sums.
+ */
+static void sum_rows(const uint32_t *src, const size_t src_w, const size_t count, uint32_t *sums) {
+    assert(count > 0);
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(src);
+    const size_t n = src_w * 4;
+    const size_t pitch = src_w * 4;
+    size_t i = 0;
+#ifdef __SSE2__
+    const size_t chunk = 257; // 257*255 is the largest sum of bytes fitting in 16 bits
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i total[4] = { zero, zero, zero, zero };
+        for (size_t r0 = 0; r0 < count; r0 += chunk) {
+            __m128i lo = _mm_setzero_si128();
+            __m128i hi = _mm_setzero_si128();
+            for (size_t r = r0; r < std::min(count, r0 + chunk); r++) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + r*pitch + i));
+                lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero));
+                hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero));
+            }
+            total[0] = _mm_add_epi32(total[0], _mm_unpacklo_epi16(lo, zero));
+            total[1] = _mm_add_epi32(total[1], _mm_unpackhi_epi16(lo, zero));
+            total[2] = _mm_add_epi32(total[2], _mm_unpacklo_epi16(hi, zero));
+            total[3] = _mm_add_epi32(total[3], _mm_unpackhi_epi16(hi, zero));
+        }
+        for (size_t k = 0; k < 4; k++)
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(sums + i + 4*k), total[k]);
+    }
+#endif
+    for (; i < n; i++) {
+        uint32_t sum = 0;
+        for (size_t r = 0; r < count; r++) sum += bytes[r*pitch + i];
+        sums[i] = sum;
+    }
+}
+
+#ifdef CPU_DISPATCH_AVX
+
+/**
+ * @brief Same as to_gray with AVX2, 8 pixels at a time (each 128 bit half as the SSE2 loop).
+ * 
+ * @return The number of pixels converted, the caller converts the rest.
+ */
+__attribute__((target("avx2")))
+static size_t to_gray_avx2(const uint32_t *src, const size_t count, uint8_t *dst) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i weights = _mm256_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0, 77, 150, 29, 0, 77, 150, 29, 0);
+    const __m256i round = _mm256_set1_epi32(128);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        __m256i p01 = _mm256_madd_epi16(_mm256_unpacklo_epi8(v, zero), weights); // pixels 0, 1 and 4, 5
+        __m256i p23 = _mm256_madd_epi16(_mm256_unpackhi_epi8(v, zero), weights); // pixels 2, 3 and 6, 7
+        p01 = _mm256_add_epi32(p01, _mm256_srli_epi64(p01, 32));
+        p23 = _mm256_add_epi32(p23, _mm256_srli_epi64(p23, 32));
+        __m256i luma = _mm256_unpacklo_epi64(_mm256_shuffle_epi32(p01, _MM_SHUFFLE(3, 3, 2, 0)), _mm256_shuffle_epi32(p23, _MM_SHUFFLE(3, 3, 2, 0)));
+        luma = _mm256_srli_epi32(_mm256_add_epi32(luma, round), 8);
+        luma = _mm256_packs_epi32(luma, luma);
+        luma = _mm256_packus_epi16(luma, luma);
+        uint32_t lo = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_castsi256_si128(luma)));
+        uint32_t hi = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_extracti128_si256(luma, 1)));
+        std::memcpy(dst + i, &lo, 4);
+        std::memcpy(dst + i + 4, &hi, 4);
+    }
+    return i;
+}
+
+/**
+ * @brief Same as to_palette with AVX2, 8 pixels at a time.
+ * 
+ * @return The number of pixels converted, the caller converts the rest.
+ */
+__attribute__((target("avx2")))
+static size_t to_palette_avx2(const uint32_t *src, const size_t count, uint8_t *dst) {
+    const __m256i mask_r = _mm256_set1_epi32(0xE0);
+    const __m256i mask_g = _mm256_set1_epi32(0x1C);
+    const __m256i mask_b = _mm256_set1_epi32(0x03);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        __m256i idx = _mm256_or_si256(_mm256_and_si256(v, mask_r),
+                      _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(v, 11), mask_g),
+                                      _mm256_and_si256(_mm256_srli_epi32(v, 22), mask_b)));
+        idx = _mm256_packs_epi32(idx, idx);
+        idx = _mm256_packus_epi16(idx, idx);
+        uint32_t lo = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_castsi256_si128(idx)));
+        uint32_t hi = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_extracti128_si256(idx, 1)));
+        std::memcpy(dst + i, &lo, 4);
+        std::memcpy(dst + i + 4, &hi, 4);
+    }
+    return i;
+}
+
+#endif // CPU_DISPATCH_AVX
+
+/**
+ * @brief Converts RGBA pixels to luma, (77*r + 150*g + 29*b) / 256.
+ * 
+ * The AVX2 variant is used when cpu_level() allows it.
+ */
+static void to_gray(const uint32_t *src, const size_t count, uint8_t *dst) {
+    size_t i = 0;
+#ifdef CPU_DISPATCH_AVX
+    if (cpu_level() >= CpuLevel::AVX2) i = to_gray_avx2(src, count, dst);
+#endif
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weights = _mm_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0);
+    const __m128i round = _mm_set1_epi32(128);
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i p01 = _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), weights); // [r*77+g*150, b*29] for pixels 0 and 1
+        __m128i p23 = _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), weights);
+        p01 = _mm_add_epi32(p01, _mm_srli_epi64(p01, 32));
+        p23 = _mm_add_epi32(p23, _mm_srli_epi64(p23, 32));
+        __m128i luma = _mm_unpacklo_epi64(_mm_shuffle_epi32(p01, _MM_SHUFFLE(3, 3, 2, 0)), _mm_shuffle_epi32(p23, _MM_SHUFFLE(3, 3, 2, 0)));
+        luma = _mm_srli_epi32(_mm_add_epi32(luma, round), 8);
+        luma = _mm_packs_epi32(luma, luma);
+        luma = _mm_packus_epi16(luma, luma);
+        uint32_t packed = static_cast<uint32_t>(_mm_cvtsi128_si32(luma));
+        std::memcpy(dst + i, &packed, 4);
+    }
+#endif
+    for (; i < count; i++) {
+        uint8_t r, g, b, a;
+        unpack_color(src[i], r, g, b, a);
+        dst[i] = static_cast<uint8_t>((77*r + 150*g + 29*b + 128) >> 8);
+    }
+}
+
+/**
+ * @brief Converts RGBA pixels to indices in the RGB332 palette (3 bits of red and green, 2 bits of blue).
+ * 
+ * The AVX2 variant is used when cpu_level() allows it.
+ */
+static void to_palette(const uint32_t *src, const size_t count, uint8_t *dst) {
+    size_t i = 0;
+#ifdef CPU_DISPATCH_AVX
+    if (cpu_level() >= CpuLevel::AVX2) i = to_palette_avx2(src, count, dst);
+#endif
+#ifdef __SSE2__
+    const __m128i mask_r = _mm_set1_epi32(0xE0);
+    const __m128i mask_g = _mm_set1_epi32(0x1C);
+    const __m128i mask_b = _mm_set1_epi32(0x03);
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i idx = _mm_or_si128(_mm_and_si128(v, mask_r),
+                      _mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 11), mask_g),
+                                   _mm_and_si128(_mm_srli_epi32(v, 22), mask_b)));
+        idx = _mm_packs_epi32(idx, idx);
+        idx = _mm_packus_epi16(idx, idx);
+        uint32_t packed = static_cast<uint32_t>(_mm_cvtsi128_si32(idx));
+        std::memcpy(dst + i, &packed, 4);
+    }
+#endif
+    for (; i < count; i++) {
+        uint8_t r, g, b, a;
+        unpack_color(src[i], r, g, b, a);
+        dst[i] = (r & 0xE0) | ((g >> 3) & 0x1C) | (b >> 6);
+    }
+}
+
+/**
+ * @brief Returns the color of an index produced by the PALETTE format.
+ * 
+ * @param index The RGB332 palette index.
+ * @return The color, with each component expanded to the full 0-255 range.
+ */
+uint32_t palette_color(const uint8_t index) {
+    return pack_color(((index >> 5) & 7) * 255 / 7, ((index >> 2) & 7) * 255 / 7, (index & 3) * 255 / 3);
+}
+
+Observation::Observation(const ObsConfig &config) : cfg(config), ring(config.stack * config.w * config.h * (config.format == ObsFormat::RGBA ? 4 : 1)),
+    head(0), filled(0), rows(), pixels(config.w * config.h) {
+    assert(cfg.w > 0 && cfg.h > 0 && cfg.stack > 0);
+}
+
+const ObsConfig &Observation::config() const {
+    return cfg;
+}
+
+size_t Observation::frame_bytes() const {
+    return cfg.w * cfg.h * (cfg.format == ObsFormat::RGBA ? 4 : 1);
+}
+
+size_t Observation::bytes() const {
+    return cfg.stack * frame_bytes();
+}
+
+void Observation::reset() {
+    head = 0;
+    filled = 0;
+}
+
+/**
+ * @brief Turns a rendered frame into the next observation.
+ * 
+ * The framebuffer is box-filtered down to the observation size (each observation pixel is
+ * the average of the framebuffer pixels it covers), unless it was rendered natively at that
+ * size. The result is converted to the configured format and pushed in the frame ring.
+ * Right after a reset, the first frame fills the whole stack.
+ * 
+ * @param fb The rendered frame, at least as large as the observation.
+ * @param out The destination buffer, bytes() bytes; frames are stored from the oldest to the newest.
+ */
+void Observation::process(const FrameBuffer &fb, uint8_t *out) {
+    AllocScope scope(ALLOC_OBSERVATION);
+    assert(fb.w >= cfg.w && fb.h >= cfg.h && fb.img.size() == fb.w*fb.h);
+
+    const uint32_t *frame = fb.img.data();
+    if (fb.w != cfg.w || fb.h != cfg.h) {
+        rows.resize(fb.w * 4);
+        for (size_t oy = 0; oy < cfg.h; oy++) {
+            const size_t y0 = oy * fb.h / cfg.h;
+            const size_t y1 = (oy + 1) * fb.h / cfg.h;
+            sum_rows(fb.img.data() + y0 * fb.w, fb.w, y1 - y0, rows.data());
+            for (size_t ox = 0; ox < cfg.w; ox++) {
+                const size_t x0 = ox * fb.w / cfg.w;
+                const size_t x1 = (ox + 1) * fb.w / cfg.w;
+                uint32_t sum[4] = {0, 0, 0, 0};
+                for (size_t x = x0; x < x1; x++) {
+                    for (size_t c = 0; c < 4; c++) sum[c] += rows[x*4 + c];
+                }
+                const uint32_t area = (x1 - x0) * (y1 - y0);
+                pixels[ox + oy * cfg.w] = pack_color((sum[0] + area/2) / area, (sum[1] + area/2) / area, (sum[2] + area/2) / area, (sum[3] + area/2) / area);
+            }
+        }
+        frame = pixels.data();
+    }
+
+    const size_t n = frame_bytes();
+    uint8_t *slot = ring.data() + head * n;
+    switch (cfg.format) {
+        case ObsFormat::RGBA:    std::memcpy(slot, frame, n); break;
+        case ObsFormat::GRAY:    to_gray(frame, cfg.w * cfg.h, slot); break;
+        case ObsFormat::PALETTE: to_palette(frame, cfg.w * cfg.h, slot); break;
+    }
+
+    if (!filled) { // no history yet: repeat the first frame
+        for (size_t k = 0; k < cfg.stack; k++) {
+            if (k != head) std::memcpy(ring.data() + k * n, slot, n);
+        }
+        filled = cfg.stack;
+    }
+    head = (head + 1) % cfg.stack;
+
+    for (size_t k = 0; k < cfg.stack; k++) { // head is now the oldest frame
+        std::memcpy(out + k * n, ring.data() + ((head + k) % cfg.stack) * n, n);
+    }
+}
@@ -3,7 +3,21 @@
 
 #include "../include/headers/player.h"
 
-Player::Player(float x, float y, float a, float fov) : x(x), y(y), a(a), fov(fov), turn(0), walk(0) {}
+/**
+ * @brief Packs an action in one byte: 2 bits for each direction, 1 bit for each flag.
+ * 
+ * @param action The action to encode.
+ * @return The encoded action.
+ */
+uint8_t encode_action(const Action &action) {
+    return static_cast<uint8_t>((action.turn + 1) | ((action.walk + 1) << 2) | (action.shoot << 4) | (action.use << 5));
+}
+
+Action decode_action(const uint8_t input) {
+    return Action{ (input & 3) - 1, ((input >> 2) & 3) - 1, ((input >> 4) & 1) != 0, ((input >> 5) & 1) != 0 };
+}
+
+Player::Player(float x, float y, float a, float fov) : x(x), y(y), a(a), fov(fov), turn(0), walk(0), shooting(false), shooting_time(0) {}
 
 /**
  * @brief Updates the player's position based on the current movement and direction.
@@ -13,7 +27,7 @@ Player::Player(float x, float y, float a, float fov) : x(x), y(y), a(a), fov(fov
  * angle is modified by the turning value, and the new position is calculated using
  * trigonometric functions. The function ensures that the new position is within the
  * bounds of the map and that the target positions are empty before updating the
- * player's coordinates.
+ * player's coordinates. It also advances the shooting animation by one tick.
  *
  * @param map A reference to the Map object representing the game world.
  */
@@ -27,8 +41,8 @@ void Player::update_position(const Map &map) {
         if (map.is_empty(x, ny)) y = ny;
     }
 
-    // Reset shooting after 100 milliseconds
-    if (shooting && std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - shooting_time).count() >= 100) {
+    // Reset shooting after shooting_ticks ticks; counting ticks instead of measuring time keeps the simulation deterministic
+    if (shooting && --shooting_time <= 0) {
         shooting = false;
     }
 }
@@ -89,22 +103,54 @@ void Player::handle_event(const SDL_Event &event, Map &map, std::vector<Sprite>
         if ('d' == event.key.keysym.sym) turn = 1;
         if ('w' == event.key.keysym.sym) walk = 1;
         if ('s' == event.key.keysym.sym) walk = -1;
-        if ('f' == event.key.keysym.sym) {
-            size_t i = static_cast<size_t>(x);
-            size_t j = static_cast<size_t>(y);
-            if (map.get(i, j) == 9) { // Open the door if the player is standing in front of it
-                auto [di, dj] = map.check_door(i, j);
-                if (di != 0 || dj != 0) {
-                    map.open_door(i + di, j + dj);
-                }
-            }
-        }
+        if ('f' == event.key.keysym.sym) use_door(map);
     }
     if (SDL_MOUSEBUTTONDOWN == event.type) {
-        if (event.button.button == SDL_BUTTON_LEFT || event.button.button == SDL_BUTTON_RIGHT) {
-            shooting = true;
-            shooting_time = std::chrono::high_resolution_clock::now();
-            check_and_remove_hit_monster(monsters); // Check if a monster is hit
+        if (event.button.button == SDL_BUTTON_LEFT || event.button.button == SDL_BUTTON_RIGHT) shoot(monsters);
+    }
+}
+
+/**
+ * @brief Applies an agent action to the player.
+ * 
+ * This is the event-free counterpart of handle_event: the walk and turn directions are
+ * taken as they are, while the shoot and use flags trigger the same logic as the mouse
+ * buttons and the 'f' key.
+ * 
+ * @param action The action to apply for the current tick.
+ * @param map The game map, used for interactions like opening doors.
+ * @param monsters The monsters that can be hit when shooting.
+ */
+void Player::apply_action(const Action &action, Map &map, std::vector<Sprite> &monsters) {
+    turn = action.turn;
+    walk = action.walk;
+    if (action.use) use_door(map);
+    if (action.shoot) shoot(monsters);
+}
+
+/**
+ * @brief Opens the door next to the player, if the player is standing in front of one.
+ * 
+ * @param map The game map containing the doors.
+ */
+void Player::use_door(Map &map) {
+    size_t i = static_cast<size_t>(x);
+    size_t j = static_cast<size_t>(y);
+    if (map.get(i, j) == 9) { // Open the door if the player is standing in front of it
+        auto [di, dj] = map.check_door(i, j);
+        if (di != 0 || dj != 0) {
+            map.open_door(i + di, j + dj);
         }
     }
+}
+
+/**
+ * @brief Fires the gun: starts the shooting animation and removes the hit monsters.
+ * 
+ * @param monsters The monsters that can be hit.
+ */
+void Player::shoot(std::vector<Sprite> &monsters) {
+    shooting = true;
+    shooting_time = shooting_ticks;
+    check_and_remove_hit_monster(monsters); // Check if a monster is hit
 }
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include <new>
+#include <memory>
+
+#include "../include/headers/raycaster.h"
+#include "../include/headers/tinyraycaster.h"
+#include "../include/headers/observation.h"
+#include "../include/headers/snapshot.h"
+
+// The opaque handle behind the C API
+struct rc_game {
+    GameState initial; // state restored by rc_reset
+    GameState gs;
+    FrameBuffer fb;
+    std::unique_ptr<Observation> observation; // set by rc_set_observation
+};
+
+struct rc_snapshot {
+    Snapshot snapshot;
+};
+
+uint32_t rc_api_version(void) {
+    return RC_API_VERSION;
+}
+
+/**
+ * @brief Creates a game instance.
+ * 
+ * Textures come from the process-wide TextureCache, so all the games created by one process
+ * share them.
+ * 
+ * @param asset_dir The directory containing the "texture" folder, NULL for the working directory.
+ * @param width The width of the rendered frames.
+ * @param height The height of the rendered frames.
+ * @return The new game, or NULL if the textures cannot be loaded.
+ */
+rc_game *rc_create(const char *asset_dir, size_t width, size_t height) {
+    if (!width || !height) return nullptr;
+    try {
+        GameState gs = new_game(asset_dir ? asset_dir : "");
+        if (!gs.tex_walls->count || !gs.tex_monst->count || !gs.tex_gun->count) return nullptr;
+        return new rc_game{ gs, gs, FrameBuffer{width, height, std::vector<uint32_t>(width*height)}, nullptr };
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void rc_destroy(rc_game *game) {
+    delete game;
+}
+
+void rc_reset(rc_game *game) {
+    game->gs = game->initial;
+    if (game->observation) game->observation->reset();
+}
+
+/**
+ * @brief Applies an action and advances the game.
+ * 
+ * The action is applied on the first tick only (shooting or opening a door once), the walk
+ * and turn directions are kept for the following ones.
+ * 
+ * @param game The game to advance.
+ * @param action The action to apply.
+ * @param ticks The number of ticks to simulate.
+ */
+void rc_step(rc_game *game, const rc_action *action, uint32_t ticks) {
+    step(game->gs, Action{action->turn, action->walk, action->shoot != 0, action->use != 0}, ticks);
+}
+
+void rc_render(rc_game *game) {
+    render(game->fb, game->gs, nullptr);
+}
+
+rc_frame rc_get_frame(const rc_game *game) {
+    const FrameBuffer &fb = game->fb;
+    return rc_frame{ fb.img.data(), fb.w, fb.h, fb.w * sizeof(uint32_t) };
+}
+
+void rc_enable_aux(rc_game *game, int with_depth, int with_labels) {
+    game->fb.enable_aux(with_depth != 0, with_labels != 0);
+}
+
+const float *rc_get_depth(const rc_game *game) {
+    return game->fb.depth.empty() ? nullptr : game->fb.depth.data();
+}
+
+const uint16_t *rc_get_labels(const rc_game *game) {
+    return game->fb.labels.empty() ? nullptr : game->fb.labels.data();
+}
+
+size_t rc_set_observation(rc_game *game, size_t width, size_t height, uint32_t format, size_t stack) {
+    if (!width || !height || !stack || width > game->fb.w || height > game->fb.h || format > RC_OBS_PALETTE) return 0;
+    game->observation = std::make_unique<Observation>(ObsConfig{width, height, static_cast<ObsFormat>(format), stack});
+    return game->observation->bytes();
+}
+
+void rc_observe(rc_game *game, uint8_t *out) {
+    if (game->observation) game->observation->process(game->fb, out);
+}
+
+rc_snapshot *rc_snapshot_create(void) {
+    try {
+        return new rc_snapshot{ Snapshot() };
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void rc_snapshot_destroy(rc_snapshot *snapshot) {
+    delete snapshot;
+}
+
+void rc_save(const rc_game *game, rc_snapshot *snapshot) {
+    snapshot->snapshot.save(game->gs);
+}
+
+int rc_restore(rc_game *game, const rc_snapshot *snapshot) {
+    return snapshot->snapshot.restore(game->gs) ? 1 : 0;
+}
+
+void rc_get_player(const rc_game *game, float *x, float *y, float *a) {
+    if (x) *x = game->gs.player.x;
+    if (y) *y = game->gs.player.y;
+    if (a) *a = game->gs.player.a;
+}
+
+size_t rc_monster_count(const rc_game *game) {
+    return game->gs.monsters.size();
+}
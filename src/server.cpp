@@ -0,0 +1,346 @@
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#include "../include/headers/server.h"
+#include "../include/headers/alloctrack.h"
+
+template <typename T> static void put(std::vector<uint8_t> &packet, const T &value) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+    packet.insert(packet.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T> static bool get(const uint8_t *data, const size_t size, size_t &offset, T &value) {
+    if (offset + sizeof(T) > size) return false;
+    std::memcpy(&value, data + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+/**
+ * @brief Copies the part of a game state that clients receive.
+ * 
+ * The frame storage is reused, so capturing does not allocate once the frame has held as
+ * many monsters and cells.
+ * 
+ * @param gs The game state.
+ * @param frame The destination frame.
+ */
+void capture_frame(const GameState &gs, SessionFrame &frame) {
+    frame.tick = gs.tick;
+    frame.x = gs.player.x;
+    frame.y = gs.player.y;
+    frame.a = gs.player.a;
+    frame.shooting = gs.player.shooting;
+    frame.monsters.assign(gs.monsters.begin(), gs.monsters.end());
+    std::sort(frame.monsters.begin(), frame.monsters.end(), [](const Sprite &l, const Sprite &r) { return l.id < r.id; });
+    frame.cells.clear();
+    gs.map.modified_cells(frame.cells);
+}
+
+/**
+ * @brief Writes a state, delta-compressed against a frame the client already has.
+ * 
+ * The player is always written. Monsters are written only if they moved or appeared,
+ * removed monsters as their id alone, and map cells only if they changed. Both monster
+ * lists are sorted by id, so they are compared in a single merge pass.
+ * 
+ * Layout: [tick u32][base tick u32][x, y, a f32][shooting u8][monsters u16]
+ *         [changed u16][(id u32, x f32, y f32)...][removed u16][id u32...][cells u16][(index u32, value u8)...]
+ * 
+ * @param frame The state to send.
+ * @param base The frame acknowledged by the client, nullptr to send the full state.
+ * @param packet The packet the state is appended to.
+ */
+void encode_state(const SessionFrame &frame, const SessionFrame *base, std::vector<uint8_t> &packet) {
+    put(packet, frame.tick);
+    put(packet, base ? base->tick : no_base);
+    put(packet, frame.x); put(packet, frame.y); put(packet, frame.a);
+    put(packet, static_cast<uint8_t>(frame.shooting));
+    put(packet, static_cast<uint16_t>(frame.monsters.size()));
+
+    static const std::vector<Sprite> no_monsters;
+    const std::vector<Sprite> &old = base ? base->monsters : no_monsters;
+
+    size_t count_at = packet.size();
+    uint16_t changed = 0;
+    put(packet, changed);
+    size_t j = 0;
+    for (const Sprite &m : frame.monsters) {
+        while (j < old.size() && old[j].id < m.id) j++;
+        if (j < old.size() && old[j].id == m.id && old[j].x == m.x && old[j].y == m.y) continue;
+        put(packet, m.id); put(packet, m.x); put(packet, m.y);
+        changed++;
+    }
+    std::memcpy(packet.data() + count_at, &changed, sizeof(changed));
+
+    count_at = packet.size();
+    uint16_t removed = 0;
+    put(packet, removed);
+    j = 0;
+    for (const Sprite &m : old) {
+        while (j < frame.monsters.size() && frame.monsters[j].id < m.id) j++;
+        if (j < frame.monsters.size() && frame.monsters[j].id == m.id) continue;
+        put(packet, m.id);
+        removed++;
+    }
+    std::memcpy(packet.data() + count_at, &removed, sizeof(removed));
+
+    count_at = packet.size();
+    uint16_t cells = 0;
+    put(packet, cells);
+    for (const auto &cell : frame.cells) {
+        if (base && std::find(base->cells.begin(), base->cells.end(), cell) != base->cells.end()) continue;
+        put(packet, cell.first); put(packet, cell.second);
+        cells++;
+    }
+    std::memcpy(packet.data() + count_at, &cells, sizeof(cells));
+}
+
+/**
+ * @brief Rebuilds a frame from a state written by encode_state().
+ * 
+ * @param data The state, after the message header.
+ * @param size The size of the state in bytes.
+ * @param base The frame of the base tick, can be nullptr for a full state.
+ * @param frame The rebuilt frame.
+ * @param base_tick Set to the base tick of the packet (no_base for a full state).
+ * @return false if the packet is malformed or the base frame is missing.
+ */
+bool decode_state(const uint8_t *data, const size_t size, const SessionFrame *base, SessionFrame &frame, uint32_t &base_tick) {
+    size_t offset = 0;
+    uint32_t tick;
+    uint8_t shooting;
+    uint16_t total, count;
+    if (!get(data, size, offset, tick) || !get(data, size, offset, base_tick)) return false;
+    if (base_tick != no_base && (!base || base->tick != base_tick)) return false;
+
+    if (base_tick == no_base) {
+        frame.monsters.clear();
+        frame.cells.clear();
+    } else if (&frame != base) {
+        frame.monsters = base->monsters;
+        frame.cells = base->cells;
+    }
+    frame.tick = tick;
+    if (!get(data, size, offset, frame.x) || !get(data, size, offset, frame.y) || !get(data, size, offset, frame.a)) return false;
+    if (!get(data, size, offset, shooting) || !get(data, size, offset, total) || !get(data, size, offset, count)) return false;
+    frame.shooting = shooting != 0;
+
+    for (uint16_t n = 0; n < count; n++) {
+        Sprite m{0, 0, 0, 0};
+        if (!get(data, size, offset, m.id) || !get(data, size, offset, m.x) || !get(data, size, offset, m.y)) return false;
+        auto it = std::lower_bound(frame.monsters.begin(), frame.monsters.end(), m.id, [](const Sprite &l, uint32_t id) { return l.id < id; });
+        if (it != frame.monsters.end() && it->id == m.id) {
+            it->x = m.x;
+            it->y = m.y;
+        } else {
+            frame.monsters.insert(it, m);
+        }
+    }
+
+    if (!get(data, size, offset, count)) return false;
+    for (uint16_t n = 0; n < count; n++) {
+        uint32_t id;
+        if (!get(data, size, offset, id)) return false;
+        frame.monsters.erase(std::remove_if(frame.monsters.begin(), frame.monsters.end(), [id](const Sprite &m) { return m.id == id; }), frame.monsters.end());
+    }
+
+    if (!get(data, size, offset, count)) return false;
+    for (uint16_t n = 0; n < count; n++) {
+        std::pair<uint32_t, char> cell;
+        if (!get(data, size, offset, cell.first) || !get(data, size, offset, cell.second)) return false;
+        auto it = std::lower_bound(frame.cells.begin(), frame.cells.end(), cell.first, [](const std::pair<uint32_t, char> &l, uint32_t k) { return l.first < k; });
+        if (it != frame.cells.end() && it->first == cell.first) it->second = cell.second;
+        else frame.cells.insert(it, cell);
+    }
+    return frame.monsters.size() == total;
+}
+
+/**
+ * @brief Opens the server socket and starts the worker threads.
+ * 
+ * @param initial The state every new session starts from; its textures are not needed.
+ * @param config The port, threads, tick period and session limits.
+ */
+GameServer::GameServer(const GameState &initial, const ServerConfig &config) : cfg(config), initial(initial), transport(config.port), pool(config.threads, config.pin_threads),
+    next_id(1), sent(0), full_count(0), delta_count(0), busy_total(0), busy_ticks(0), busy_average(0) {}
+
+bool GameServer::ok() const {
+    return transport.ok();
+}
+
+size_t GameServer::sessions() const {
+    return list.size();
+}
+
+double GameServer::busy_ms() const {
+    return busy_average;
+}
+
+size_t GameServer::bytes_sent() const {
+    return sent;
+}
+
+size_t GameServer::full_states() const {
+    return full_count;
+}
+
+size_t GameServer::delta_states() const {
+    return delta_count;
+}
+
+GameServer::Session *GameServer::find(const uint32_t id, const size_t peer) {
+    auto it = index.find(id);
+    if (it == index.end() || list[it->second].peer != peer) return nullptr; // sessions only accept packets from their own client
+    return &list[it->second];
+}
+
+void GameServer::remove(const uint32_t id) {
+    auto it = index.find(id);
+    if (it == index.end()) return;
+    const size_t pos = it->second;
+    index.erase(it);
+    joins.erase((uint64_t(list[pos].peer) << 32) | list[pos].token);
+    if (pos != list.size() - 1) {
+        list[pos] = std::move(list.back());
+        index[list[pos].id] = pos;
+    }
+    list.pop_back();
+}
+
+void GameServer::handle_packet(const size_t peer) {
+    size_t offset = 0;
+    uint8_t type;
+    uint32_t id;
+    if (!get(packet.data(), packet.size(), offset, type) || !get(packet.data(), packet.size(), offset, id)) return;
+
+    if (type == MSG_JOIN) { // id is the client token here
+        const uint64_t key = (uint64_t(peer) << 32) | id;
+        auto join = joins.find(key);
+        uint32_t session_id;
+        if (join != joins.end()) { // the welcome was lost, send it again
+            session_id = join->second;
+        } else {
+            if (list.size() >= cfg.max_sessions) return;
+            session_id = next_id++;
+            Session session{ session_id, peer, id, initial, encode_action(Action{0, 0, false, false}), no_base,
+                             std::vector<SessionFrame>(history), std::chrono::steady_clock::now(), {}, false };
+            for (SessionFrame &frame : session.frames) { // so that the ticks of the session do not allocate
+                frame.monsters.reserve(initial.monsters.size());
+            }
+            session.out.reserve(64 + initial.monsters.size() * 12 + initial.map.w * initial.map.h * 5); // a full state with every cell modified
+            index[session_id] = list.size();
+            joins[key] = session_id;
+            list.push_back(std::move(session));
+        }
+        packet.clear();
+        put(packet, static_cast<uint8_t>(MSG_WELCOME));
+        put(packet, id);
+        put(packet, session_id);
+        transport.send(peer, packet.data(), packet.size());
+        return;
+    }
+
+    Session *session = find(id, peer);
+    if (!session) return;
+    if (type == MSG_INPUT) {
+        uint32_t ack;
+        uint8_t input;
+        if (!get(packet.data(), packet.size(), offset, ack) || !get(packet.data(), packet.size(), offset, input)) return;
+        session->input = input;
+        if (session->acked == no_base || (ack != no_base && ack > session->acked)) session->acked = ack;
+        session->last_heard = std::chrono::steady_clock::now();
+    } else if (type == MSG_LEAVE) {
+        remove(id);
+    }
+}
+
+void GameServer::drop_silent_sessions() {
+    const auto deadline = std::chrono::steady_clock::now() - std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(cfg.timeout_s));
+    for (size_t i = 0; i < list.size(); ) {
+        if (list[i].last_heard < deadline) remove(list[i].id);
+        else i++;
+    }
+}
+
+/**
+ * @brief Runs one server tick.
+ * 
+ * The network is handled by the calling thread; the sessions are simulated and their state
+ * packets built in parallel by the worker pool, as the sessions share nothing but the
+ * immutable base layout of the map.
+ */
+void GameServer::tick() {
+    const auto start = std::chrono::steady_clock::now();
+
+    size_t peer;
+    while (transport.receive(peer, packet)) {
+        handle_packet(peer);
+    }
+
+    pool.parallel_for(list.size(), [&](size_t i) {
+        AllocScope scope(ALLOC_NETWORK);
+        Session &s = list[i];
+        GameState &gs = s.gs;
+        gs.player.apply_action(decode_action(s.input), gs.map, gs.monsters);
+        s.input &= 0x0F; // shooting and doors happen once per input
+        simulate(gs);
+
+        SessionFrame &frame = s.frames[gs.tick % history];
+        capture_frame(gs, frame);
+        const SessionFrame *base = nullptr;
+        if (s.acked != no_base && gs.tick - s.acked < history && s.frames[s.acked % history].tick == s.acked) {
+            base = &s.frames[s.acked % history];
+        }
+        s.out.clear();
+        put(s.out, static_cast<uint8_t>(MSG_STATE));
+        put(s.out, s.id);
+        encode_state(frame, base, s.out);
+        s.delta = base != nullptr;
+    });
+
+    for (Session &s : list) {
+        transport.send(s.peer, s.out.data(), s.out.size());
+        sent += s.out.size();
+        (s.delta ? delta_count : full_count)++;
+    }
+    drop_silent_sessions();
+
+    busy_total += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    busy_ticks++;
+    alloc_frame_end();
+}
+
+/**
+ * @brief Ticks at the configured period until stop is set.
+ * 
+ * Once per second it prints the number of sessions, the time spent per tick and the
+ * resulting capacity estimate in sessions per core.
+ * 
+ * @param stop Flag to set (e.g. from a signal handler) to leave the loop.
+ */
+void GameServer::run(const std::atomic<bool> &stop) {
+    const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(cfg.tick_ms));
+    auto next = std::chrono::steady_clock::now();
+    auto report = next + std::chrono::seconds(1);
+    size_t last_sent = 0;
+    while (!stop) {
+        tick();
+        next += period;
+        if (std::chrono::steady_clock::now() >= report) {
+            busy_average = busy_total / std::max<size_t>(busy_ticks, 1);
+            double capacity = busy_average > 0 ? list.size() * cfg.tick_ms / busy_average / pool.size() : 0;
+            std::cout << "sessions " << list.size() << " | tick " << busy_average << " ms | " << (sent - last_sent) / 1024 << " KiB/s"
+                      << " | full " << full_count << " delta " << delta_count << " | ~" << static_cast<size_t>(capacity) << " sessions/core" << std::endl;
+            if (alloc_tracking()) alloc_report(stdout, alloc_frame()); // allocations of the last tick
+            busy_total = 0;
+            busy_ticks = 0;
+            last_sent = sent;
+            report += std::chrono::seconds(1);
+        }
+        std::this_thread::sleep_until(next);
+    }
+}
@@ -0,0 +1,217 @@
+#include <cassert>
+#include <cstring>
+
+#include "../include/headers/snapshot.h"
+
+Snapshot::Snapshot(const size_t capacity) : buffer(capacity), used(0), cells() {
+    cells.reserve(64);
+}
+
+template <typename T> void Snapshot::write(const T &value) {
+    if (used + sizeof(T) > buffer.size()) buffer.resize(2 * (used + sizeof(T))); // only if the preallocated capacity was too small
+    std::memcpy(buffer.data() + used, &value, sizeof(T));
+    used += sizeof(T);
+}
+
+template <typename T> T Snapshot::read(size_t &offset) const {
+    assert(offset + sizeof(T) <= used);
+    T value;
+    std::memcpy(&value, buffer.data() + offset, sizeof(T));
+    offset += sizeof(T);
+    return value;
+}
+
+template <typename T> bool Snapshot::read_checked(size_t &offset, T &value) const {
+    if (offset > used || used - offset < sizeof(T)) return false;
+    std::memcpy(&value, buffer.data() + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+bool Snapshot::check_player(size_t &offset) const {
+    float f;
+    int i;
+    uint8_t shooting;
+    for (size_t k = 0; k < 4; k++)
+        if (!read_checked(offset, f)) return false;
+    return read_checked(offset, i) && read_checked(offset, i) && read_checked(offset, shooting) && shooting <= 1 && read_checked(offset, i);
+}
+
+/**
+ * @brief Checks the whole snapshot before anything is restored from it.
+ * 
+ * The bytes may come from outside (a file, the network), so every count and index is checked
+ * against the bytes actually there and against the game it is restored into.
+ * 
+ * @param map_cells The number of cells of the map, 0 to accept the count of the snapshot.
+ * @param monster_frames The number of frames of the monster texture, 0 to accept any texture index.
+ * @param wall_textures The number of wall textures, 0 to accept any digit as a map cell.
+ * @param players Set to whether a list of players follows the game state.
+ * @return false if the snapshot is truncated, has extra bytes, or holds counts, cell indices or values out of range.
+ */
+bool Snapshot::check(const size_t map_cells, const size_t monster_frames, const size_t wall_textures, bool &players) const {
+    size_t offset = 0;
+    uint32_t tick, monsters, cells_count, count;
+    if (!read_checked(offset, tick) || !check_player(offset) || !read_checked(offset, monsters)) return false;
+    if (monsters > (used - offset) / sizeof(Sprite)) return false;
+    for (uint32_t n = 0; n < monsters; n++) {
+        Sprite monster;
+        read_checked(offset, monster);
+        if (monster_frames && monster.tex_id >= monster_frames) return false;
+    }
+
+    if (!read_checked(offset, cells_count) || (map_cells && cells_count != map_cells)) return false;
+    if (!read_checked(offset, count) || count > cells_count) return false;
+    for (uint32_t n = 0; n < count; n++) {
+        uint32_t index;
+        char value;
+        if (!read_checked(offset, index) || !read_checked(offset, value) || index >= cells_count) return false;
+        const bool wall = value >= '0' && value <= '9' && (!wall_textures || value == '9' || size_t(value - '0') < wall_textures);
+        if (value != ' ' && !wall) return false;
+    }
+
+    players = offset != used;
+    if (!players) return true;
+    if (!read_checked(offset, count) || count > used - offset) return false;
+    for (uint32_t n = 0; n < count; n++)
+        if (!check_player(offset)) return false;
+    return offset == used;
+}
+
+/**
+ * @brief Saves the mutable state of a game.
+ * 
+ * The textures are shared and immutable, and the map is stored as the list of cells that
+ * differ from its base layout, so a snapshot is a few hundred bytes for the default level.
+ * 
+ * @param gs The game state to save.
+ */
+void Snapshot::save(const GameState &gs) {
+    used = 0;
+    write(gs.tick);
+
+    write_player(gs.player);
+
+    write(static_cast<uint32_t>(gs.monsters.size()));
+    for (const Sprite &monster : gs.monsters) {
+        write(monster);
+    }
+
+    cells.clear();
+    gs.map.modified_cells(cells);
+    write(static_cast<uint32_t>(gs.map.w * gs.map.h));
+    write(static_cast<uint32_t>(cells.size()));
+    for (const auto &cell : cells) {
+        write(cell.first);
+        write(cell.second);
+    }
+}
+
+/**
+ * @brief Puts a game back in the saved state.
+ * 
+ * The monsters list and the map keep their storage, so restoring does not allocate once
+ * the game has held as many monsters and modified chunks as the snapshot.
+ * 
+ * @param gs The game state to overwrite.
+ * @return false, leaving gs unchanged, if the snapshot is malformed or belongs to another level.
+ */
+bool Snapshot::restore(GameState &gs) const {
+    bool players;
+    if (!check(gs.map.w * gs.map.h, gs.tex_monst ? gs.tex_monst->count : 0, gs.tex_walls ? gs.tex_walls->count : 0, players)) return false;
+    restore_state(gs);
+    return true;
+}
+
+size_t Snapshot::restore_state(GameState &gs) const {
+    size_t offset = 0;
+    gs.tick = read<uint32_t>(offset);
+
+    read_player(gs.player, offset);
+
+    gs.monsters.resize(read<uint32_t>(offset));
+    for (Sprite &monster : gs.monsters) {
+        monster = read<Sprite>(offset);
+    }
+
+    const uint32_t map_cells = read<uint32_t>(offset);
+    assert(map_cells == gs.map.w * gs.map.h); // checked by check()
+    (void)map_cells;
+    cells.resize(read<uint32_t>(offset));
+    for (auto &cell : cells) {
+        cell.first = read<uint32_t>(offset);
+        cell.second = read<char>(offset);
+    }
+    gs.map.restore(cells.data(), cells.size());
+    return offset;
+}
+
+/**
+ * @brief Saves a multiplayer game: the state shared by the players and every player.
+ * 
+ * @param gs The game state to save.
+ * @param players The players of the session.
+ */
+void Snapshot::save(const GameState &gs, const std::vector<Player> &players) {
+    save(gs);
+    write(static_cast<uint32_t>(players.size()));
+    for (const Player &p : players) {
+        write_player(p);
+    }
+}
+
+/**
+ * @brief Puts a multiplayer game back in the saved state.
+ * 
+ * @param gs The game state to overwrite.
+ * @param players The players of the session, resized to the saved count.
+ * @return false, leaving the game unchanged, if the snapshot is malformed, belongs to another level or has no players.
+ */
+bool Snapshot::restore(GameState &gs, std::vector<Player> &players) const {
+    bool with_players;
+    if (!check(gs.map.w * gs.map.h, gs.tex_monst ? gs.tex_monst->count : 0, gs.tex_walls ? gs.tex_walls->count : 0, with_players) || !with_players) return false;
+    size_t offset = restore_state(gs);
+    uint32_t count = read<uint32_t>(offset);
+    players.resize(count, gs.player);
+    for (Player &p : players) {
+        read_player(p, offset);
+    }
+    return true;
+}
+
+void Snapshot::write_player(const Player &p) {
+    write(p.x); write(p.y); write(p.a); write(p.fov);
+    write(p.turn); write(p.walk);
+    write(p.shooting); write(p.shooting_time);
+}
+
+void Snapshot::read_player(Player &p, size_t &offset) const {
+    p.x = read<float>(offset); p.y = read<float>(offset); p.a = read<float>(offset); p.fov = read<float>(offset);
+    p.turn = read<int>(offset); p.walk = read<int>(offset);
+    p.shooting = read<bool>(offset); p.shooting_time = read<int>(offset);
+}
+
+const uint8_t *Snapshot::data() const {
+    return buffer.data();
+}
+
+size_t Snapshot::size() const {
+    return used;
+}
+
+/**
+ * @brief Copies a snapshot serialized elsewhere, e.g. received from the network.
+ * 
+ * @param bytes The bytes of the snapshot, as returned by data().
+ * @param n The number of bytes.
+ * @return false, leaving the snapshot empty, if the bytes are not a whole snapshot.
+ */
+bool Snapshot::load(const uint8_t *bytes, const size_t n) {
+    if (n > buffer.size()) buffer.resize(n);
+    std::memcpy(buffer.data(), bytes, n);
+    used = n;
+    bool players;
+    if (check(0, 0, 0, players)) return true;
+    used = 0;
+    return false;
+}
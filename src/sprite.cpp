@@ -22,6 +22,7 @@ void Sprite::update_position(const Player& player, const Map& map, float speed)
     float direction_x = player.x - x;
     float direction_y = player.y - y;
     float length = std::sqrt(direction_x * direction_x + direction_y * direction_y);
+    if (length < 1e-6f) return; // already on the player, the direction is undefined
     
     // Normalize the direction vector
     direction_x /= length;
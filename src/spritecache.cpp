@@ -0,0 +1,157 @@
+#include <cassert>
+#include <algorithm>
+
+#include "../include/headers/spritecache.h"
+
+/**
+ * @brief Creates an empty cache.
+ *
+ * @param budget The bytes of images kept while no frame uses them.
+ */
+SpriteCache::SpriteCache(const size_t budget) : budget(budget), total_bytes(0), clock(0) {}
+
+/**
+ * @brief Builds the image of a level of a sprite frame.
+ *
+ * Every texel of the level averages the block of texels of the texture it covers: the alpha is
+ * the mean alpha, the color the mean color of the texels weighted by their alpha, so that the
+ * transparent texels around the sprite do not darken its edges.
+ *
+ * @param texture The texture holding the sprite frames.
+ * @param idx The index of the frame in the texture.
+ * @param level The level, the image being (size >> level) texels wide.
+ * @return The new entry, not in the cache yet.
+ */
+SpriteCache::Entry *SpriteCache::build(const std::shared_ptr<const Texture> &texture, const size_t idx, const size_t level) {
+    const Texture &tex = *texture;
+    const size_t size = std::max<size_t>(1, tex.size >> level);
+    Entry *entry = new Entry{ texture, texture.get(), idx, level, std::vector<uint32_t>(size * size), size, 0, 0 };
+
+    for (size_t i = 0; i < size; i++) {
+        const size_t x0 = i * tex.size / size, x1 = (i + 1) * tex.size / size;
+        for (size_t j = 0; j < size; j++) {
+            const size_t y0 = j * tex.size / size, y1 = (j + 1) * tex.size / size;
+            if (x1 - x0 == 1 && y1 - y0 == 1) { // level 0, a copy of the texture
+                entry->texels[i * size + j] = tex.get(x0, y0, idx);
+                continue;
+            }
+            uint64_t r = 0, g = 0, b = 0, alpha = 0;
+            for (size_t x = x0; x < x1; x++) {
+                for (size_t y = y0; y < y1; y++) {
+                    const uint32_t texel = tex.get(x, y, idx);
+                    const uint32_t a = texel >> 24;
+                    r += (texel & 255) * a;
+                    g += (texel >> 8 & 255) * a;
+                    b += (texel >> 16 & 255) * a;
+                    alpha += a;
+                }
+            }
+            const uint64_t n = (x1 - x0) * (y1 - y0);
+            uint32_t color = 0;
+            if (alpha) color = uint32_t((r + alpha / 2) / alpha) | uint32_t((g + alpha / 2) / alpha) << 8 | uint32_t((b + alpha / 2) / alpha) << 16;
+            entry->texels[i * size + j] = color | uint32_t((alpha + n / 2) / n) << 24;
+        }
+    }
+    return entry;
+}
+
+/**
+ * @brief Returns the image of a level of a sprite frame, building it on first use.
+ *
+ * The image stays valid until it is released, even if the cache goes over its budget meanwhile.
+ *
+ * @param texture The texture holding the sprite frames.
+ * @param idx The index of the frame in the texture.
+ * @param level The level, see level_for().
+ * @return The image, to be released with release().
+ */
+SpriteImage SpriteCache::acquire(const std::shared_ptr<const Texture> &texture, const size_t idx, const size_t level) {
+    assert(texture && idx < texture->count);
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry *entry = nullptr;
+    for (const auto &e : entries) {
+        if (e->texture_key == texture.get() && e->idx == idx && e->level == level && !e->texture.expired()) {
+            entry = e.get();
+            break;
+        }
+    }
+    if (!entry) {
+        entries.emplace_back(build(texture, idx, level));
+        entry = entries.back().get();
+        total_bytes += entry->texels.size() * sizeof(uint32_t);
+    }
+    entry->users++;
+    entry->last_use = ++clock;
+    evict();
+    return SpriteImage{ entry->texels.data(), entry->size, entry };
+}
+
+/**
+ * @brief Unpins an image, which may then be evicted to stay within the budget.
+ *
+ * @param image The image returned by acquire().
+ */
+void SpriteCache::release(const SpriteImage &image) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry *entry = static_cast<Entry *>(const_cast<void *>(image.entry));
+    assert(entry && entry->users > 0);
+    entry->users--;
+    evict();
+}
+
+/**
+ * @brief Drops the images no frame uses, those of textures no longer alive first, then the least
+ * recently used ones, until the cache is within its budget.
+ */
+void SpriteCache::evict() {
+    for (size_t i = 0; i < entries.size();) {
+        if (!entries[i]->users && entries[i]->texture.expired()) {
+            total_bytes -= entries[i]->texels.size() * sizeof(uint32_t);
+            entries[i] = std::move(entries.back());
+            entries.pop_back();
+        }
+        else i++;
+    }
+    while (total_bytes > budget) {
+        size_t oldest = entries.size();
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (!entries[i]->users && (oldest == entries.size() || entries[i]->last_use < entries[oldest]->last_use)) oldest = i;
+        }
+        if (oldest == entries.size()) break; // everything left is in use
+        total_bytes -= entries[oldest]->texels.size() * sizeof(uint32_t);
+        entries[oldest] = std::move(entries.back());
+        entries.pop_back();
+    }
+}
+
+size_t SpriteCache::level_for(const size_t tex_size, const size_t screen_size) {
+    size_t level = 0;
+    while ((tex_size >> (level + 1)) >= std::max<size_t>(screen_size, 1)) level++;
+    return level;
+}
+
+void SpriteCache::set_budget(const size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    budget = bytes;
+    evict();
+}
+
+size_t SpriteCache::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return total_bytes;
+}
+
+size_t SpriteCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+/**
+ * @brief Returns the cache shared by all the frames of the process.
+ *
+ * @return The cache, created on the first call.
+ */
+SpriteCache &SpriteCache::shared() {
+    static SpriteCache cache;
+    return cache;
+}
@@ -1,5 +1,7 @@
 #include <iostream>
 #include <cassert>
+#include <map>
+#include <mutex>
 
 #include "../include/sdl/SDL.h"
 
@@ -78,11 +80,76 @@ uint32_t Texture::get(const size_t i, const size_t j, const size_t idx) const {
     return img[i+idx*size+j*img_w];
 }
 
+const uint32_t *Texture::column(const size_t i, const size_t idx) const {
+    assert(i<size && idx<count);
+    return img.data() + i + idx*size;
+}
+
 std::vector<uint32_t> Texture::get_scaled_column(const size_t texture_id, const size_t tex_coord, const size_t column_height) const {
-    assert(tex_coord<size && texture_id<count);
     std::vector<uint32_t> column(column_height);
+    get_scaled_column(texture_id, tex_coord, column_height, column.data());
+    return column;
+}
+
+void Texture::get_scaled_column(const size_t texture_id, const size_t tex_coord, const size_t column_height, uint32_t *column) const {
+    assert(tex_coord<size && texture_id<count);
     for (size_t y=0; y<column_height; y++) {
         column[y] = get(tex_coord, (y*size)/column_height, texture_id);
     }
-    return column;
+}
+
+// Cache entries only hold weak references: a texture is freed as soon as the last game using it is gone
+static std::mutex cache_mutex;
+static std::map<std::pair<std::string, uint32_t>, std::weak_ptr<const Texture>> cache;
+
+/**
+ * @brief Drops the cache entries whose texture has been freed.
+ * 
+ * @note The cache mutex must be held by the caller.
+ */
+static void purge_expired() {
+    for (auto it = cache.begin(); it != cache.end(); ) {
+        if (it->second.expired()) it = cache.erase(it);
+        else ++it;
+    }
+}
+
+/**
+ * @brief Returns the texture loaded from the given file in the given format.
+ * 
+ * The image is loaded only if no live handle to it exists, so any number of game instances
+ * share one copy of each texture. Textures that fail to load are returned (with count == 0,
+ * as the Texture constructor leaves them) but not cached, so that a later call can retry.
+ * 
+ * @param filename The path to the BMP image file.
+ * @param format The desired pixel format for the texture.
+ * @return A shared handle to the immutable texture.
+ */
+std::shared_ptr<const Texture> TextureCache::load(const std::string &filename, const uint32_t format) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    purge_expired();
+
+    auto key = std::make_pair(filename, format);
+    auto it = cache.find(key);
+    if (it != cache.end()) {
+        if (auto texture = it->second.lock()) return texture;
+    }
+
+    auto texture = std::make_shared<const Texture>(filename, format);
+    if (texture->count) cache[key] = texture;
+    return texture;
+}
+
+void TextureCache::purge() {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    purge_expired();
+}
+
+size_t TextureCache::size() {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    size_t count = 0;
+    for (const auto &entry : cache) {
+        if (!entry.second.expired()) count++;
+    }
+    return count;
 }
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include <cassert>
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "../include/headers/threadpool.h"
+
+// Pool and queue of the calling thread, when it is one of the workers of a pool
+static thread_local const ThreadPool *current_pool = nullptr;
+static thread_local size_t current_queue = 0;
+
+bool ThreadPool::Queue::push(const Job &job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (tail - head == capacity) return false;
+    jobs[tail++ % capacity] = job;
+    return true;
+}
+
+bool ThreadPool::Queue::pop(Job &job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (head == tail) return false;
+    job = jobs[--tail % capacity];
+    return true;
+}
+
+bool ThreadPool::Queue::steal(Job &job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (head == tail) return false;
+    job = jobs[head++ % capacity];
+    return true;
+}
+
+/**
+ * @brief Starts the worker threads.
+ * 
+ * The calling thread takes part in every parallel_for, so only threads-1 workers are spawned.
+ * 
+ * @param threads The total number of threads, 0 to use one thread per hardware core.
+ * @param pin Bind every worker to its own core (only on Linux), leaving the first core to the calling thread.
+ */
+ThreadPool::ThreadPool(size_t threads, const bool pin) : queued(0), sleeping(0), quit(false) {
+    if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+    queues.reset(new Queue[threads]);
+    for (size_t i=0; i+1<threads; i++) {
+        workers.emplace_back(&ThreadPool::worker_loop, this, i);
+#ifdef __linux__
+        if (pin) {
+            cpu_set_t cores;
+            CPU_ZERO(&cores);
+            CPU_SET((i + 1) % std::max(1u, std::thread::hardware_concurrency()), &cores);
+            pthread_setaffinity_np(workers.back().native_handle(), sizeof(cores), &cores);
+        }
+#else
+        (void)pin;
+#endif
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers) worker.join();
+}
+
+size_t ThreadPool::size() const {
+    return workers.size() + 1;
+}
+
+ThreadPool &ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+size_t ThreadPool::queue_index() const {
+    return current_pool == this ? current_queue : workers.size();
+}
+
+/**
+ * @brief Takes a job: the newest one of the own queue, or else the oldest one of another queue.
+ * 
+ * Taking the own jobs in LIFO order keeps their data in cache, stealing the oldest ones moves
+ * the largest remaining pieces of work to the idle threads.
+ * 
+ * @param own The queue of the calling thread.
+ * @param job Receives the job.
+ * @return false if every queue is empty.
+ */
+bool ThreadPool::take(const size_t own, Job &job) {
+    if (!queued.load()) return false;
+    bool found = queues[own].pop(job);
+    for (size_t k = 1; !found && k < size(); k++) {
+        found = queues[(own + k) % size()].steal(job);
+    }
+    if (found) queued--;
+    return found;
+}
+
+/**
+ * @brief Wakes the sleeping threads after jobs were queued or a counter reached 0.
+ * 
+ * The mutex is taken so that a thread checking its wake condition cannot miss the change
+ * before it starts waiting.
+ */
+void ThreadPool::notify() {
+    if (!sleeping.load()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+    wake.notify_all();
+}
+
+void ThreadPool::run(const Job &job) {
+    {
+        AllocScope scope(job.tag);
+        job.fn(job.data, job.begin, job.end);
+    }
+    if (job.counter && job.counter->pending.fetch_sub(1) == 1) notify();
+}
+
+/**
+ * @brief Queues a job in the queue of the calling thread.
+ * 
+ * If the queue is full, the job runs immediately on the calling thread. Whichever thread runs
+ * it, its allocations are charged to the AllocScope of the calling thread.
+ * 
+ * @param job The job, counted in job.counter until it completes.
+ */
+void ThreadPool::submit(const Job &job) {
+    Job tagged = job;
+    tagged.tag = alloc_tag();
+    if (tagged.counter) tagged.counter->pending++;
+    queued++; // counted before it is visible, so that the count never goes below the number of queued jobs
+    if (!queues[queue_index()].push(tagged)) {
+        queued--;
+        run(tagged);
+        return;
+    }
+    notify();
+}
+
+/**
+ * @brief Runs queued jobs, of any loop, until the counter reaches 0.
+ * 
+ * When there is nothing left to take the thread sleeps until new jobs are queued or the counter
+ * reaches 0, so jobs can wait for other jobs (e.g. nested parallel loops) without blocking a core.
+ * 
+ * @param counter The counter to wait for.
+ */
+void ThreadPool::wait(JobCounter &counter) {
+    const size_t own = queue_index();
+    while (counter.pending.load()) {
+        Job job;
+        if (take(own, job)) {
+            run(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        sleeping++;
+        wake.wait(lock, [&] { return !counter.pending.load() || queued.load(); });
+        sleeping--;
+    }
+}
+
+void ThreadPool::worker_loop(const size_t index) {
+    current_pool = this;
+    current_queue = index;
+    while (true) {
+        Job job;
+        if (take(index, job)) {
+            run(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        sleeping++;
+        wake.wait(lock, [&] { return quit || queued.load(); });
+        sleeping--;
+        if (quit) return;
+    }
+}
+
+/**
+ * @brief Runs fn over ranges covering [0, n) across the pool and waits for completion.
+ * 
+ * The ranges are queued by the calling thread, which runs the first one and then helps with
+ * the others (or with any other job) while they are not finished; idle threads steal the rest.
+ * The loop body may itself call parallel_for on the same pool. The ranges run by other threads
+ * are charged to the AllocScope of the calling thread, as its own range.
+ * 
+ * @param n The number of iterations.
+ * @param grain The number of iterations of a range, 0 for about four ranges per thread.
+ * @param fn The loop body, called with the first and past-the-end iterations of each range.
+ */
+void ThreadPool::parallel_for_range(const size_t n, size_t grain, const std::function<void(size_t, size_t)> &fn) {
+    if (!n) return;
+    if (!grain) grain = std::max<size_t>(1, n / (size() * 4));
+    if (workers.empty() || n <= grain) {
+        fn(0, n);
+        return;
+    }
+
+    JobCounter counter;
+    Job job{ [](void *data, size_t begin, size_t end) { (*static_cast<const std::function<void(size_t, size_t)> *>(data))(begin, end); },
+             const_cast<void *>(static_cast<const void *>(&fn)), 0, 0, &counter, alloc_tag() };
+    const size_t ranges = (n + grain - 1) / grain;
+    counter.pending = ranges - 1;
+    Queue &own = queues[queue_index()];
+    queued += ranges - 1;
+    for (size_t r = ranges - 1; r > 0; r--) { // the last ranges first: the caller pops the first ones back in order
+        job.begin = r * grain;
+        job.end = std::min(n, job.begin + grain);
+        if (!own.push(job)) {
+            queued--;
+            run(job);
+        }
+    }
+    notify();
+
+    fn(0, std::min(n, grain));
+    wait(counter);
+}
+
+/**
+ * @brief Runs fn(i) for every i in [0, n) across the pool and waits for completion.
+ * 
+ * @param n The number of iterations.
+ * @param fn The loop body, called once per iteration with the iteration index.
+ */
+void ThreadPool::parallel_for(const size_t n, const std::function<void(size_t)> &fn) {
+    parallel_for_range(n, 0, [&fn](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) fn(i);
+    });
+}
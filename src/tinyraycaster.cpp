@@ -2,9 +2,17 @@
 #include <cmath>
 #include <iostream>
 #include <cassert>
+#include <algorithm>
 
 #include "../include/headers/utils.h"
 #include "../include/headers/tinyraycaster.h"
+#include "../include/headers/arena.h"
+#include "../include/headers/alloctrack.h"
+#include "../include/headers/columns.h"
+#include "../include/headers/kernels.h"
+#include "../include/headers/threadpool.h"
+#include "../include/headers/framegraph.h"
+#include "../include/headers/spritecache.h"
 
 /**
  * @brief Calculates the texture coordinate for a wall hit in a raycasting engine.
@@ -35,13 +43,36 @@ int wall_x_texcoord(const float hitx, const float hity, const Texture &tex_walls
 }
 
 /**
- * @brief Draws the map, player, visibility cone, and sprites onto the framebuffer.
+ * @brief Fills a rectangle of a layer, clipped to its right and bottom edges.
+ *
+ * @param img The pixels of the layer.
+ * @param img_w The width of the layer.
+ * @param img_h The height of the layer.
+ * @param rect_x The x-coordinate of the upper left corner.
+ * @param rect_y The y-coordinate of the upper left corner.
+ * @param rect_w The width of the rectangle.
+ * @param rect_h The height of the rectangle.
+ * @param color The color of the rectangle.
+ */
+static void fill_rectangle(uint32_t *img, const size_t img_w, const size_t img_h, const size_t rect_x, const size_t rect_y, const size_t rect_w, const size_t rect_h, const uint32_t color) {
+    if (rect_x >= img_w || rect_y >= img_h) return;
+    const size_t x1 = std::min(rect_x + rect_w, img_w);
+    const size_t y1 = std::min(rect_y + rect_h, img_h);
+    for (size_t y = rect_y; y < y1; y++)
+        std::fill(img + y * img_w + rect_x, img + y * img_w + x1, color);
+}
+
+/**
+ * @brief Draws the map, player, visibility cone, and sprites onto the minimap layer.
  *
  * This function renders the map grid, player position, visibility cone, and sprites
- * onto the provided framebuffer. The map is drawn using the wall textures, and the
- * player and sprites are represented by colored rectangles.
+ * onto a layer covering the lower right corner of the screen, composited over the 3D view
+ * afterwards. The map is drawn using the wall textures, and the player and sprites are
+ * represented by colored rectangles.
  *
- * @param fb The framebuffer to draw onto.
+ * @param layer The pixels of the layer, layer_w * layer_h.
+ * @param layer_w The width of the layer, map.w * cell_w.
+ * @param layer_h The height of the layer, map.h * cell_h.
  * @param sprites A vector of sprites to be drawn on the map.
  * @param tex_walls The texture containing wall textures.
  * @param map The map data structure containing the layout of the map.
@@ -49,78 +80,275 @@ int wall_x_texcoord(const float hitx, const float hity, const Texture &tex_walls
  * @param cell_w The width of each cell in the map grid.
  * @param cell_h The height of each cell in the map grid.
  */
-void draw_map(FrameBuffer &fb, const std::vector<Sprite> &sprites, const Texture &tex_walls, const Map &map, const Player &player, const size_t cell_w, const size_t cell_h) {
-    size_t start_x = fb.w - map.w * cell_w;
-    size_t start_y = fb.h - map.h * cell_h;
-
+void draw_map(uint32_t *layer, const size_t layer_w, const size_t layer_h, const std::vector<Sprite> &sprites, const Texture &tex_walls, const Map &map, const Player &player, const size_t cell_w, const size_t cell_h) {
     for (size_t j = 0; j < map.h; j++) {  // draw the map itself
         
         for (size_t i = 0; i < map.w; i++) {
-            size_t rect_x = start_x + i * cell_w;
-            size_t rect_y = start_y + j * cell_h;
+            size_t rect_x = i * cell_w;
+            size_t rect_y = j * cell_h;
 
             if (map.is_empty(i, j)) { // fill the floor
-                fb.draw_rectangle(rect_x, rect_y, cell_w, cell_h, tex_walls.get(0, 0, 2));
+                fill_rectangle(layer, layer_w, layer_h, rect_x, rect_y, cell_w, cell_h, tex_walls.get(0, 0, 2));
                 continue;
             }
 
             size_t texid = map.get(i, j);
             assert(texid < tex_walls.count);
-            fb.draw_rectangle(rect_x, rect_y, cell_w, cell_h, tex_walls.get(0, 0, texid)); // the color is taken from the upper left pixel of the texture #texid
+            fill_rectangle(layer, layer_w, layer_h, rect_x, rect_y, cell_w, cell_h, tex_walls.get(0, 0, texid)); // the color is taken from the upper left pixel of the texture #texid
         }
     }
 
     // Draw the player on the map
-    size_t player_map_x = start_x + player.x * cell_w;
-    size_t player_map_y = start_y + player.y * cell_h;
-    fb.draw_rectangle(player_map_x, player_map_y, cell_w / 2, cell_h / 2, pack_color(0, 255, 0));
+    size_t player_map_x = player.x * cell_w;
+    size_t player_map_y = player.y * cell_h;
+    fill_rectangle(layer, layer_w, layer_h, player_map_x, player_map_y, cell_w / 2, cell_h / 2, pack_color(0, 255, 0));
 
     // !!! Draw the visibility cone here if necessary !!!
 
     // Draw the sprites on the map
     for (const auto &sprite : sprites) {
-        size_t sprite_map_x = start_x + sprite.x * cell_w;
-        size_t sprite_map_y = start_y + sprite.y * cell_h;
-        fb.draw_rectangle(sprite_map_x, sprite_map_y, cell_w / 2, cell_h / 2, pack_color(255, 0, 0));
+        size_t sprite_map_x = sprite.x * cell_w;
+        size_t sprite_map_y = sprite.y * cell_h;
+        fill_rectangle(layer, layer_w, layer_h, sprite_map_x, sprite_map_y, cell_w / 2, cell_h / 2, pack_color(255, 0, 0));
     }
 }
 
+// Where a sprite is drawn on the screen: a square of size pixels with its upper left corner at (h_offset, v_offset)
+struct SpriteOnScreen {
+    float dist;        // distance from the player
+    int h_offset, v_offset;
+    size_t size;
+    bool visible;      // false when the sprite is too far to be drawn
+    uint32_t fog;      // weight of the fog blended over the sprite, see RenderSettings::fog_weight()
+    SpriteImage image; // texels drawn, set by list_sprite_spans()
+};
+
 /**
- * @brief Draws a sprite on the framebuffer.
- *
- * This function renders a sprite on the screen based on the player's position and orientation.
- * It takes into account the depth buffer to handle occlusion and uses a texture to draw the sprite.
+ * @brief Projects a sprite on the screen.
  *
- * @param sprite The sprite to be drawn, containing its position and texture ID.
+ * @param sprite The sprite to project.
  * @param player The player object, containing the player's position and viewing angle.
- * @param fb The framebuffer where the sprite will be drawn.
- * @param depth_buffer A vector containing depth information for each column of the screen.
- * @param tex_monst The texture object used to draw the sprite.
+ * @param fb The framebuffer the sprite is drawn into.
+ * @param settings The settings of the frame, for the distance of the farthest sprites drawn.
+ * @return The square of the screen covered by the sprite.
  */
-void draw_sprite(const Sprite &sprite, const Player &player, FrameBuffer &fb, const std::vector<float> &depth_buffer, const Texture &tex_monst) {
+static SpriteOnScreen project_sprite(const Sprite &sprite, const Player &player, const FrameBuffer &fb, const RenderSettings &settings) {
     float sprite_dir = atan2(sprite.y - player.y, sprite.x - player.x);
     while (sprite_dir - player.a > M_PI) sprite_dir -= 2 * M_PI;
     while (sprite_dir - player.a < -M_PI) sprite_dir += 2 * M_PI;
 
     float sprite_dist = sqrt(pow(sprite.x - player.x, 2) + pow(sprite.y - player.y, 2));
-    if (sprite_dist > 15) return; // Skip drawing distant sprites
+    if (sprite_dist > settings.sprite_distance || settings.fog_weight(sprite_dist) == 256) // Skip drawing distant sprites
+        return SpriteOnScreen{ sprite_dist, 0, 0, 0, false, 0, {} };
 
     size_t sprite_screen_size = std::min(1000, static_cast<int>(fb.h / sprite_dist)); // screen sprite size
     int h_offset = (sprite_dir - player.a) * (fb.w) / (player.fov) + (fb.w) / 2 - sprite_screen_size / 2; // full screen width
     int v_offset = fb.h / 2 - sprite_screen_size / 2;
+    return SpriteOnScreen{ sprite_dist, h_offset, v_offset, sprite_screen_size, true, settings.fog_weight(sprite_dist), {} };
+}
 
-    for (size_t i = 0; i < sprite_screen_size; i++) {
-        if (h_offset + int(i) < 0 || h_offset + i >= fb.w) continue;
-        if (depth_buffer[h_offset + i] < sprite_dist) continue; // this sprite column is occluded
-        for (size_t j = 0; j < sprite_screen_size; j++) {
-            if (v_offset + int(j) < 0 || v_offset + j >= fb.h) continue;
-            uint32_t color = tex_monst.get(i * tex_monst.size / sprite_screen_size, j * tex_monst.size / sprite_screen_size, sprite.tex_id);
-            uint8_t r, g, b, a;
-            unpack_color(color, r, g, b, a);
-            if (a > 128)
-                fb.set_pixel(h_offset + i, v_offset + j, color);
+static constexpr size_t TILE = 64; // width of the sprite bands and of the tiles of draw_view_tiled, and height of each of their two bands
+
+// Minimum and maximum of the depth buffer over any range of columns in O(1) (sparse table): the level k
+// holds the bounds of the 2^k columns starting at each column
+struct DepthBounds {
+    static constexpr size_t max_levels = 24;
+    const float *min[max_levels], *max[max_levels];
+
+    // bounds of the columns [x0, x1), not empty
+    void query(const size_t x0, const size_t x1, float &lo, float &hi) const {
+        assert(x0 < x1);
+        const size_t k = 63 - __builtin_clzll(x1 - x0); // two ranges of 2^k columns cover [x0, x1)
+        const size_t x = x1 - (size_t(1) << k);
+        lo = std::min(min[k][x0], min[k][x]);
+        hi = std::max(max[k][x0], max[k][x]);
+    }
+};
+
+/**
+ * @brief Builds the sparse table of the depth buffer, in O(w log w).
+ *
+ * The levels live in the FrameArena of the calling thread.
+ *
+ * @param depth_buffer The depth of each column, w values.
+ * @param w The number of columns.
+ * @return The table.
+ */
+static DepthBounds depth_bounds(const float *depth_buffer, const size_t w) {
+    FrameArena &arena = FrameArena::local();
+    DepthBounds bounds;
+    bounds.min[0] = bounds.max[0] = depth_buffer;
+    for (size_t k = 1; (size_t(1) << k) <= w; k++) {
+        assert(k < DepthBounds::max_levels);
+        const size_t half = size_t(1) << (k - 1), count = w - (size_t(1) << k) + 1;
+        float *lo = arena.alloc<float>(count), *hi = arena.alloc<float>(count);
+        for (size_t x = 0; x < count; x++) {
+            lo[x] = std::min(bounds.min[k - 1][x], bounds.min[k - 1][x + half]);
+            hi[x] = std::max(bounds.max[k - 1][x], bounds.max[k - 1][x + half]);
         }
+        bounds.min[k] = lo;
+        bounds.max[k] = hi;
     }
+    return bounds;
+}
+
+// Sprites showing in each screen column, not occluded by its wall: the column x shows
+// sprites[index[k]] for k in [first[x], first[x+1]), from the farthest to the closest
+struct SpriteSpans {
+    SpriteOnScreen *sprites; // one per monster
+    uint32_t *first;         // fb.w + 1 values
+    uint32_t *index;
+    SpriteImage *images;     // images pinned in the SpriteCache for the frame, for each sprite frame and level (texels nullptr if unused)
+    size_t image_count;
+    uint32_t fog_color;
+};
+
+/**
+ * @brief Projects the sprites and lists the ones showing in every column of the screen.
+ *
+ * A sprite shows in a column it covers when the wall of the column is not closer. The range of
+ * columns of a sprite is first tested as a whole with the bounds of its walls (see DepthBounds),
+ * so that only the sprites partially hidden are tested column by column. The lists are built in
+ * one sweep counting the sprites of every column and one filling them, and live in the FrameArena
+ * of the calling thread.
+ *
+ * Every sprite drawn gets the image of its frame from the SpriteCache: the texture itself, stored
+ * column by column, or with RenderSettings::sprite_lod and a sprite smaller than its texture, the
+ * level of the size closest above its size on the screen. The images stay pinned until
+ * release_sprite_images().
+ *
+ * @param fb The framebuffer the sprites are drawn into.
+ * @param gs The game state, its monsters sorted from the farthest to the closest.
+ * @param depth_buffer The depth information for each column of the screen, fb.w values.
+ * @param settings The settings of the frame.
+ * @return The lists.
+ */
+static SpriteSpans list_sprite_spans(const FrameBuffer &fb, const GameState &gs, const float *depth_buffer, const RenderSettings &settings) {
+    FrameArena &arena = FrameArena::local();
+    const size_t count = gs.monsters.size();
+    const Texture &tex_monst = *gs.tex_monst;
+    const size_t levels = SpriteCache::level_for(tex_monst.size, 1) + 1;
+    SpriteSpans spans{ arena.alloc<SpriteOnScreen>(count), arena.alloc<uint32_t>(fb.w + 1, 0), nullptr,
+                       arena.alloc<SpriteImage>(tex_monst.count * levels, SpriteImage{ nullptr, 0, nullptr }), tex_monst.count * levels,
+                       settings.fog_color };
+
+    // columns [x0[i], x1[i]) covered by the sprite i on the screen, empty when it is hidden by the walls;
+    // a sprite closer than all the walls of its columns is drawn in all of them without testing them
+    const DepthBounds bounds = depth_bounds(depth_buffer, fb.w);
+    int *x0 = arena.alloc<int>(count), *x1 = arena.alloc<int>(count);
+    bool *in_front = arena.alloc<bool>(count);
+    for (size_t i = 0; i < count; i++) {
+        SpriteOnScreen &s = spans.sprites[i] = project_sprite(gs.monsters[i], gs.player, fb, settings);
+        if (s.size < settings.min_sprite_size) s.visible = false;
+        x0[i] = std::max(0, s.h_offset);
+        x1[i] = s.visible ? std::min(static_cast<int>(fb.w), s.h_offset + static_cast<int>(s.size)) : 0;
+        in_front[i] = false;
+        if (x0[i] >= x1[i]) continue;
+        float nearest, farthest;
+        bounds.query(x0[i], x1[i], nearest, farthest);
+        if (farthest < s.dist) {
+            x1[i] = x0[i];
+            continue;
+        }
+        in_front[i] = nearest >= s.dist;
+
+        const size_t level = settings.sprite_lod ? SpriteCache::level_for(tex_monst.size, s.size) : 0;
+        SpriteImage &image = spans.images[gs.monsters[i].tex_id * levels + level];
+        if (!image.texels) image = SpriteCache::shared().acquire(gs.tex_monst, gs.monsters[i].tex_id, level);
+        s.image = image;
+        for (int x = x0[i]; x < x1[i]; x++)
+            if (in_front[i] || depth_buffer[x] >= s.dist) spans.first[x + 1]++;
+    }
+    for (size_t x = 0; x < fb.w; x++) spans.first[x + 1] += spans.first[x];
+
+    spans.index = arena.alloc<uint32_t>(spans.first[fb.w]);
+    uint32_t *next = arena.alloc<uint32_t>(fb.w);
+    std::copy(spans.first, spans.first + fb.w, next);
+    for (size_t i = 0; i < count; i++)
+        for (int x = x0[i]; x < x1[i]; x++)
+            if (in_front[i] || depth_buffer[x] >= spans.sprites[i].dist) spans.index[next[x]++] = i;
+    return spans;
+}
+
+// Unpins the images of the sprites of a frame, once it is drawn
+static void release_sprite_images(const SpriteSpans &spans) {
+    for (size_t k = 0; k < spans.image_count; k++)
+        if (spans.images[k].texels) SpriteCache::shared().release(spans.images[k]);
+}
+
+/**
+ * @brief Draws the sprites showing in the rows [y0, y1) of a column, from the closest to the farthest.
+ *
+ * Each pixel takes the texel of the closest sprite with an opaque texel there, as when the sprites
+ * are drawn over each other from the farthest, but is written once, and the column is done as soon
+ * as all its rows covered by the sprites are drawn.
+ *
+ * @param fb The framebuffer to draw into.
+ * @param spans The sprites of every column, see list_sprite_spans().
+ * @param x The column.
+ * @param y0 The first row.
+ * @param y1 The row after the last one.
+ * @param covered Scratch flags, one per row of the framebuffer.
+ */
+static void draw_sprite_column(FrameBuffer &fb, const SpriteSpans &spans, const size_t x, const int y0, const int y1, uint8_t *covered) {
+    const size_t begin = spans.first[x], end = spans.first[x + 1];
+    if (begin == end) return;
+
+    // rows covered by the sprites: they all stand on the horizon, so their spans are nested and all of them get drawn
+    int top = y1, bottom = y0;
+    for (size_t k = begin; k < end; k++) {
+        const SpriteOnScreen &s = spans.sprites[spans.index[k]];
+        top = std::min(top, std::max(y0, s.v_offset));
+        bottom = std::max(bottom, std::min(y1, s.v_offset + static_cast<int>(s.size)));
+    }
+    if (top >= bottom) return;
+    std::fill(covered + top, covered + bottom, 0);
+    size_t remaining = bottom - top;
+
+    const bool aux = fb.has_aux();
+    for (size_t k = end; k-- > begin && remaining;) {
+        const size_t i = spans.index[k];
+        const SpriteOnScreen &s = spans.sprites[i];
+        const int j0 = std::max(0, y0 - s.v_offset); // rows of the sprite inside [y0, y1)
+        const int j1 = std::min(static_cast<int>(s.size), y1 - s.v_offset);
+        if (j0 >= j1) continue;
+        const uint32_t *texels = s.image.texels + (x - s.h_offset) * s.image.size / s.size * s.image.size;
+        TexStepper v(j0 * s.image.size, s.image.size, s.size); // image row j*size/screen_size
+        if (s.fog)
+            remaining -= draw_column_under<RGBA32, Blend::ALPHA_MASK, Shade::FOG>(aux, fb, x, s.v_offset + j0, s.v_offset + j1, texels, 1, v, s.dist, LABEL_MONSTER + i, covered,
+                                                                                 0, nullptr, FogBlend{ spans.fog_color, s.fog });
+        else
+            remaining -= draw_column_under<RGBA32, Blend::ALPHA_MASK, Shade::NONE>(aux, fb, x, s.v_offset + j0, s.v_offset + j1, texels, 1, v, s.dist, LABEL_MONSTER + i, covered);
+    }
+}
+
+/**
+ * @brief Draws the sprites (monsters).
+ *
+ * The sprites showing in every column are listed first, then every column draws its own from
+ * the closest, so the cost depends on the sprites actually visible rather than on all the columns
+ * of all the sprites. With a pool, the columns are drawn in parallel by bands of TILE columns.
+ *
+ * @param fb The framebuffer to draw into.
+ * @param gs The game state, its monsters sorted from the farthest to the closest.
+ * @param depth_buffer The depth information for each column of the screen, fb.w values.
+ * @param settings The settings of the frame.
+ * @param pool The pool drawing the bands, nullptr to draw on the calling thread.
+ */
+static void draw_sprites(FrameBuffer &fb, const GameState &gs, const float *depth_buffer, const RenderSettings &settings, ThreadPool *pool) {
+    FrameArena &arena = FrameArena::local();
+    const SpriteSpans spans = list_sprite_spans(fb, gs, depth_buffer, settings);
+    const size_t bands = (fb.w + TILE - 1) / TILE;
+    uint8_t *covered = arena.alloc<uint8_t>(bands * fb.h); // flags of the rows, for each band
+
+    auto draw_bands = [&](const size_t begin, const size_t end) {
+        for (size_t b = begin; b < end; b++)
+            for (size_t x = b * TILE; x < std::min(fb.w, (b + 1) * TILE); x++)
+                draw_sprite_column(fb, spans, x, 0, fb.h, covered + b * fb.h);
+    };
+    if (pool) pool->parallel_for_range(bands, 1, draw_bands);
+    else draw_bands(0, bands);
+    release_sprite_images(spans);
 }
 
 /**<
@@ -128,7 +356,8 @@ void draw_sprite(const Sprite &sprite, const Player &player, FrameBuffer &fb, co
  *
  * This function scales and draws a gun sprite from the provided texture onto the framebuffer.
  * The gun sprite is centered horizontally and positioned at the bottom of the screen.
- * The sprite is scaled by a factor specified by `scale_factor`.
+ * The sprite is scaled by a factor specified by `scale_factor`, reduced when the framebuffer
+ * is smaller than the 1200x600 window (e.g. for agent observations).
  * White pixels in the sprite are considered transparent and are not drawn.
  *
  * @param fb The framebuffer to draw the gun sprite onto.
@@ -137,6 +366,7 @@ void draw_sprite(const Sprite &sprite, const Player &player, FrameBuffer &fb, co
  */
 void draw_gun(FrameBuffer &fb, const Texture &tex_gun, bool use_firing_sprite) {
     float scale_factor = 1; // Adjust this value to make the weapon larger
+    scale_factor = std::min(scale_factor, std::min(fb.h / 600.f, fb.w / float(tex_gun.img_w / 2))); // shrink the weapon on framebuffers smaller than the window
 
     // Determine the sprite index based on the use_firing_sprite flag
     size_t sprite_index = use_firing_sprite ? 1 : 0;
@@ -149,121 +379,336 @@ void draw_gun(FrameBuffer &fb, const Texture &tex_gun, bool use_firing_sprite) {
     size_t gun_x = (fb.w - gun_w) / 2;
     size_t gun_y = fb.h - gun_h;
 
-    // Draw the scaled gun sprite
-    for (size_t y = 0; y < gun_h; y++) {
-        for (size_t x = 0; x < gun_w; x++) {
-            // Calculate the corresponding pixel in the original sprite
-            size_t orig_x = static_cast<size_t>(x / scale_factor);
-            size_t orig_y = static_cast<size_t>(y / scale_factor);
-
-            // Get the pixel from the correct sprite based on sprite_index
-            uint32_t color = tex_gun.get(orig_x, orig_y, sprite_index);
-
-            // Skip the white pixels
-            if (color != pack_color(255, 255, 255)) {
-                fb.set_pixel(gun_x + x, gun_y + y, color);
-            }
+    const bool aux = fb.has_aux();
+    const uint32_t white = pack_color(255, 255, 255);
+
+    // Row of the original sprite of every screen row, y / scale_factor as a float division, computed once for all the columns
+    ArenaScope scratch(FrameArena::local());
+    size_t *orig_rows = FrameArena::local().alloc<size_t>(gun_h);
+    for (size_t y = 0; y < gun_h; y++)
+        orig_rows[y] = std::min(static_cast<size_t>(y / scale_factor), tex_gun.size - 1);
+
+    // Draw the scaled gun sprite column by column, skipping the white pixels
+    for (size_t x = 0; x < gun_w; x++) {
+        // Calculate the corresponding column in the original sprite
+        size_t orig_x = std::min(static_cast<size_t>(x / scale_factor), tex_gun.size - 1);
+        const uint32_t *texels = tex_gun.column(orig_x, sprite_index);
+        uint32_t *dst = fb.img.data() + gun_y * fb.w + gun_x + x;
+        for (size_t y = 0; y < gun_h; y++, dst += fb.w) {
+            const uint32_t color = texels[orig_rows[y] * tex_gun.img_w];
+            if (color == white) continue;
+            *dst = color;
+            if (aux) fb.set_aux(gun_x + x, gun_y + y, 0, LABEL_HUD);
         }
     }
 }
 
 /**
- * @brief Renders the game frame.
+ * @brief Builds the initial state of the level.
  * 
- * This function is responsible for rendering the entire game frame, including the floor, ceiling, walls, sprites, and HUD elements.
+ * The textures are taken from the process-wide TextureCache, so every game created by
+ * this function shares them. Callers should check the textures count to detect loading
+ * failures.
  * 
- * @param fb The framebuffer to render to.
- * @param gs The current game state, containing player information, textures, and map data.
- * @param renderer The SDL renderer used for rendering.
- * 
- * The rendering process includes:
- * - Clearing the screen.
- * - Drawing the floor and ceiling using ray casting.
- * - Drawing the walls using Digital Differential Analysis (DDA) for ray casting.
- * - Drawing the sprites (monsters) in the game.
- * - Drawing the map overlay on top of the 3D view.
- * - Drawing the player's gun on the screen.
- * - Checking if the player is near a door and showing a prompt to open it.
+ * @param asset_dir The directory containing the "texture" folder, empty for the working directory.
+ * @return The game state at the start of the level.
  */
-void render(FrameBuffer &fb, const GameState &gs, SDL_Renderer* renderer) {
-    fb.clear(pack_color(255, 255, 255)); // clear the screen
-
-    const Texture &tex_gun = gs.tex_gun;
-
-    // size of one map cell on the screen
-    const size_t cell_w = fb.w / (gs.map.w * 4);
-    const size_t cell_h = fb.h / (gs.map.h * 4);
-
-    std::vector<float> depth_buffer(fb.w, 1e3); // buffer to store the Z-coordinate based on the ray casting
+GameState new_game(const std::string &asset_dir) {
+    const std::string dir = asset_dir.empty() ? "" : asset_dir + "/";
+    return GameState{ Map(),                                // game map
+                      Player(2, 14, 270, M_PI/3.),          // player
+                      { {8, 14, 3, 0, 0},                   // monsters lists
+                        {9, 14.50, 3, 0, 1},
+                        {10, 13.50, 3, 0, 2}, },
+                      TextureCache::load(dir + "texture/walltext.bmp", SDL_PIXELFORMAT_ABGR8888),          // textures for the walls
+                      TextureCache::load(dir + "texture/monsters.bmp", SDL_PIXELFORMAT_ABGR8888),          // textures for the monsters
+                      TextureCache::load(dir + "texture/pistolSprites.bmp", SDL_PIXELFORMAT_ABGR8888) };   // textures for the gun
+}
 
-    // player's position
-    float posX = gs.player.x;       
-    float posY = gs.player.y;       
+/**
+ * @brief Advances the game state by one tick.
+ * 
+ * This function moves the player according to its current walk and turn directions and
+ * moves the monsters towards the player. Nothing here depends on rendering, so it can run
+ * many times between two frames (or without frames at all, e.g. for training and servers).
+ * 
+ * @param gs The game state to update.
+ */
+void simulate(GameState &gs) {
+    AllocScope scope(ALLOC_SIMULATION);
 
-    float playerViewDir = gs.player.a; // player's view direction
+    gs.player.update_position(gs.map); // Update the player's position
 
-    float playerFov = gs.player.fov;   // player's field of view
+    for (auto& monster : gs.monsters) { monster.update_position(gs.player, gs.map, 0.05f); } // Update the monsters' positions
 
-    const float aspect_ratio = float(fb.h) / fb.w; // aspect ratio of the screen
+    gs.tick++;
+}
 
-    // direction vector
-    float dirX = cos(playerViewDir);
-    float dirY = sin(playerViewDir); 
+/**
+ * @brief Prepares the monsters list for render().
+ * 
+ * render() draws the sprites in the order of the list, so they must go from farthest to
+ * closest. This is only needed before rendering, not after every simulated tick.
+ * 
+ * @param gs The game state to update.
+ */
+void sort_monsters(GameState &gs) {
+    for (size_t i=0; i<gs.monsters.size(); i++) { // update the distances from the player to each sprite
+        float dx = gs.player.x - gs.monsters[i].x;
+        float dy = gs.player.y - gs.monsters[i].y;
+        gs.monsters[i].player_dist = std::sqrt(dx * dx + dy * dy);
+    }
+    std::sort(gs.monsters.begin(), gs.monsters.end()); // sort it from farthest to closest
+}
 
-    // camera plane
-    float planeX = cos(playerViewDir + M_PI / 2) * playerFov;
-    float planeY = sin(playerViewDir + M_PI / 2) * playerFov;
+/**
+ * @brief Advances the game state by one tick and prepares it for rendering.
+ * 
+ * @param gs The game state to update.
+ */
+void update(GameState &gs) {
+    simulate(gs);
+    sort_monsters(gs);
+}
 
+/**
+ * @brief Applies an action and advances the game state by several ticks.
+ * 
+ * This is the action repeat used by agents: the walk and turn directions are kept for
+ * all the ticks, while shooting and opening doors happen once, on the first tick.
+ * The monsters are sorted once at the end, so the state can be rendered on demand.
+ * 
+ * @param gs The game state to update.
+ * @param action The action to apply.
+ * @param repeat The number of ticks to simulate.
+ */
+void step(GameState &gs, const Action &action, const size_t repeat) {
+    AllocScope scope(ALLOC_SIMULATION);
 
-    // -------------- 3D engine --------------
-    // Draw the floor and ceiling
-    for (int y = 0; y < fb.h; y++) {
-        float rayDirX0 = dirX - planeX; // vectors for right and left sides of the camera plane
-        float rayDirY0 = dirY - planeY; // the 2d ray dir without the distortion correction
-        float rayDirX1 = dirX + planeX; // vectors for right and left sides of the camera plane
-        float rayDirY1 = dirY + planeY; // the 2d ray dir without the distortion correction
-        
-        int p = y - fb.h / 2;
-        float posZ = 0.5 * fb.h;
-        float rowDistance = posZ / p;
+    gs.player.apply_action(action, gs.map, gs.monsters);
+    for (size_t t = 0; t < repeat; t++) {
+        simulate(gs);
+    }
+    sort_monsters(gs);
+}
 
-        float floorStepX = rowDistance * (rayDirX1 - rayDirX0) / fb.w;
-        float floorStepY = rowDistance * (rayDirY1 - rayDirY0) / fb.w;
+// Where the ray of a screen column hits a wall, and the rows of the column the wall covers
+struct WallHit {
+    float dist;                // distance projected on the camera direction
+    int draw_start, draw_end;  // rows of the wall slice, [draw_start, draw_end)
+    int line_height;           // height of the whole wall on the screen
+    int tex_x, wall_id;        // column of the wall texture, wall_id -1 for the fog beyond the draw distance
+    uint16_t label;
+};
+
+// Marks the cells crossed by one ray in FrameBuffer::visible_cells, a word of the bitset at a time: the rays
+// of neighboring columns cross mostly the same cells, so most words are already set and never written
+struct CellMarker {
+    uint64_t *bits; // nullptr when the set is not enabled
+    size_t map_w;
+    size_t word;    // word of the pending bits
+    uint64_t pending;
+
+    void mark(const int i, const int j) {
+        const size_t bit = size_t(i) + size_t(j) * map_w;
+        if (bit / 64 != word) {
+            flush();
+            word = bit / 64;
+        }
+        pending |= uint64_t(1) << (bit % 64);
+    }
 
-        float floorX = posX + rowDistance * rayDirX0;
-        float floorY = posY + rowDistance * rayDirY0;
+    // merge the pending bits into the set, which the rays of the other threads write too
+    void flush() {
+        if (pending && (__atomic_load_n(bits + word, __ATOMIC_RELAXED) & pending) != pending)
+            __atomic_fetch_or(bits + word, pending, __ATOMIC_RELAXED);
+        pending = 0;
+    }
+};
 
-        // Draw the floor from the bottom to the center of the screen
-        for (int x = 0; x < fb.w; ++x) {
-            int cellX = (int)(floorX);
-            int cellY = (int)(floorY);
+/**
+ * @brief Ray casting of the 3D view of one frame: the rows of the floor and the ceiling, and the columns of the walls.
+ * 
+ * The texture size and the framebuffer size are template parameters, 0 meaning that the value
+ * is read at run time: with a power of two texture size the texture coordinates are computed
+ * with shifts and masks, and with a fixed resolution the loop bounds are known to the compiler.
+ * select_view() picks the instance matching the current configuration.
+ * 
+ * The floor and ceiling rows live in the FrameArena of the calling thread.
+ * 
+ * @tparam TexSize The size of the wall textures, or 0.
+ * @tparam W The width of the framebuffer, or 0.
+ * @tparam H The height of the framebuffer, or 0.
+ */
+template <size_t TexSize, size_t W, size_t H>
+struct ViewCaster {
+    FrameBuffer &fb;
+    const GameState &gs;
+    const Texture &tex_walls;
+    const size_t size, w, h;
+    const size_t stride;                     // distance between two rows of a texture
+    const uint32_t *floor_texels, *ceiling_texels; // textures for the floor and ceiling
+    const bool aux;                          // fill the depth and label buffers along with the pixels
+    const RenderSettings &settings;          // draw distance and fog
+
+    float posX, posY;                        // player's position
+    float playerViewDir;                     // player's view direction
+    float playerFov;                         // player's field of view
+
+    // Each row of the lower half shows the floor, and its texels (darker) show the ceiling in the
+    // symmetrical row of the upper half: the row r is the screen row half + r
+    size_t half, rows_count;
+    float *row_x, *row_y;                    // map position seen by the first pixel of each row
+    float *row_step_x, *row_step_y;          // step of the position from one pixel to the next
+    float *row_distance;
+    size_t fog_rows, clear_rows;             // rows [0, fog_rows) are beyond the draw distance, rows [clear_rows, rows_count) before the fog
+    uint64_t *visible_cells;                 // cells crossed by the rays, nullptr when the framebuffer does not keep them
+    RayHit *ray_hits;                        // hit of the ray of every column, nullptr when the framebuffer does not keep them
+    FloorKernel kernel;                      // kernel for the instruction set of the processor, nullptr for the portable loop
+
+    ViewCaster(FrameBuffer &fb, const GameState &gs, const RenderSettings &settings) :
+        fb(fb), gs(gs), tex_walls(*gs.tex_walls), size(TexSize ? TexSize : tex_walls.size), w(W ? W : fb.w), h(H ? H : fb.h),
+        stride(tex_walls.img_w), floor_texels(tex_walls.column(0, 5)), ceiling_texels(tex_walls.column(0, 2)), aux(fb.has_aux()), settings(settings),
+        posX(gs.player.x), posY(gs.player.y), playerViewDir(gs.player.a), playerFov(gs.player.fov) {
+        assert(size == tex_walls.size && w == fb.w && h == fb.h && fb.img.size() == w*h);
+
+        // direction vector
+        float dirX = cos(playerViewDir);
+        float dirY = sin(playerViewDir); 
+
+        // camera plane
+        float planeX = cos(playerViewDir + M_PI / 2) * playerFov;
+        float planeY = sin(playerViewDir + M_PI / 2) * playerFov;
+
+        half = h / 2;
+        rows_count = h - half;
+        FrameArena &arena = FrameArena::local();
+        row_x = arena.alloc<float>(rows_count);
+        row_y = arena.alloc<float>(rows_count);
+        row_step_x = arena.alloc<float>(rows_count);
+        row_step_y = arena.alloc<float>(rows_count);
+        row_distance = arena.alloc<float>(rows_count);
+
+        for (size_t r = 0; r < rows_count; r++) {
+            int y = half + r;
+            float rayDirX0 = dirX - planeX; // vectors for right and left sides of the camera plane
+            float rayDirY0 = dirY - planeY; // the 2d ray dir without the distortion correction
+            float rayDirX1 = dirX + planeX; // vectors for right and left sides of the camera plane
+            float rayDirY1 = dirY + planeY; // the 2d ray dir without the distortion correction
+            
+            int p = y - h / 2;
+            float posZ = 0.5 * h;
+            float rowDistance = posZ / p;
+
+            row_step_x[r] = rowDistance * (rayDirX1 - rayDirX0) / w;
+            row_step_y[r] = rowDistance * (rayDirY1 - rayDirY0) / w;
+
+            row_x[r] = posX + rowDistance * rayDirX0;
+            row_y[r] = posY + rowDistance * rayDirY0;
+            row_distance[r] = std::abs(rowDistance);
+        }
 
-            int tx = (int)(gs.tex_walls.size * (floorX - cellX)) & (gs.tex_walls.size - 1); 
-            int ty = (int)(gs.tex_walls.size * (floorY - cellY)) & (gs.tex_walls.size - 1); 
+        // the rows get closer from the horizon down
+        fog_rows = 0;
+        while (fog_rows < rows_count && settings.fog_weight(row_distance[fog_rows]) == 256) fog_rows++;
+        clear_rows = fog_rows;
+        while (clear_rows < rows_count && settings.fog_weight(row_distance[clear_rows]) > 0) clear_rows++;
 
-            floorX += floorStepX;
-            floorY += floorStepY;
+        // the kernel draws most rows, the loop of draw_floor() the rest (and all of them when the
+        // depth and label buffers are filled too)
+        kernel = aux ? nullptr : floor_kernel(cpu_level());
 
-            // textures for the floor and ceiling
-            int floorTexture = 5;
-            int ceilingTexture = 2;
-            uint32_t color;
+        const bool cells = !fb.visible_cells.empty() && fb.visible_w == gs.map.w && fb.visible_h == gs.map.h;
+        visible_cells = cells ? fb.visible_cells.data() : nullptr;
+        ray_hits = fb.ray_hits.size() == w ? fb.ray_hits.data() : nullptr;
+    }
 
-            // floor
-            color = gs.tex_walls.get(tx, ty, floorTexture);
-            color = (color >> 1) & 8355711; // make a bit darker
-            fb.set_pixel(x, y, color);
+    /**
+     * @brief Draws the columns [x0, x1) of the floor rows [begin, end) and of their ceiling rows.
+     * 
+     * The rows beyond the draw distance are filled with the fog color without reading any texel,
+     * and the fog is blended over the rows in the fog once they are drawn.
+     * 
+     * @param xs The map position seen by the column x0 of each row, end - begin values.
+     * @param ys Same for the y-coordinate.
+     */
+    void draw_floor(const size_t begin, const size_t end, const size_t x0, const size_t x1, const float *xs, const float *ys) const {
+        // rows beyond the draw distance: only fog
+        const size_t fog_end = std::min(end, fog_rows);
+        for (size_t r = begin; r < fog_end; r++) {
+            const size_t y = half + r;
+            std::fill(fb.img.data() + y * w + x0, fb.img.data() + y * w + x1, settings.fog_color);
+            std::fill(fb.img.data() + (h - y - 1) * w + x0, fb.img.data() + (h - y - 1) * w + x1, settings.fog_color);
+            if (!aux) continue;
+            for (size_t x = x0; x < x1; x++) {
+                fb.set_aux(x, y, settings.draw_distance, LABEL_FOG);
+                fb.set_aux(x, h - y - 1, settings.draw_distance, LABEL_FOG);
+            }
+        }
+        const size_t start = std::max(begin, fog_end);
+        if (start >= end) return;
+
+        const FloorRows rows{ fb.img.data(), w, h, half + start, x0, x1, floor_texels, ceiling_texels, stride, float(size), int(size - 1),
+                              xs + (start - begin), ys + (start - begin), row_step_x + start, row_step_y + start };
+        for (size_t r = start + (kernel ? kernel(rows, end - start) : 0); r < end; r++) {
+            const size_t y = half + r;
+            float floorX = xs[r - begin];
+            float floorY = ys[r - begin];
+
+            uint32_t *floor_row = fb.img.data() + y * w;
+            uint32_t *ceiling_row = fb.img.data() + (h - y - 1) * w;
+
+            // Draw the floor from the center to the bottom of the screen
+            for (size_t x = x0; x < x1; ++x) {
+                int cellX = (int)(floorX);
+                int cellY = (int)(floorY);
+
+                int tx = (int)(size * (floorX - cellX)) & (size - 1); 
+                int ty = (int)(size * (floorY - cellY)) & (size - 1); 
+
+                floorX += row_step_x[r];
+                floorY += row_step_y[r];
+
+                uint32_t color;
+
+                // floor
+                color = floor_texels[tx + ty * stride];
+                color = (color >> 1) & 8355711; // make a bit darker
+                floor_row[x] = color;
+                if (aux) fb.set_aux(x, y, row_distance[r], LABEL_FLOOR);
+
+                // ceiling (symmetrical, at screenHeight - y - 1 instead of y)
+                color = ceiling_texels[tx + ty * stride];
+                color = (color >> 1) & 8355711; // make a bit darker
+                ceiling_row[x] = color;
+                if (aux) fb.set_aux(x, h - y - 1, row_distance[r], LABEL_CEILING);
+            }
+        }
 
-            // ceiling (symmetrical, at screenHeight - y - 1 instead of y)
-            color = gs.tex_walls.get(tx, ty, ceilingTexture);
-            color = (color >> 1) & 8355711; // make a bit darker
-            fb.set_pixel(x, fb.h - y - 1, color);
+        // rows in the fog
+        for (size_t r = start; r < std::min(end, clear_rows); r++) {
+            const FogBlend fog{ settings.fog_color, settings.fog_weight(row_distance[r]) };
+            uint32_t *floor_row = fb.img.data() + (half + r) * w;
+            uint32_t *ceiling_row = fb.img.data() + (h - half - r - 1) * w;
+            for (size_t x = x0; x < x1; x++) floor_row[x] = blend_fog(floor_row[x], fog);
+            for (size_t x = x0; x < x1; x++) ceiling_row[x] = blend_fog(ceiling_row[x], fog);
         }
     }
 
-    // Draw the walls - Ray casting with DDA
-    for (size_t x = 0; x < fb.w; x++) {
-        float ray_angle = (playerViewDir - playerFov / 2) + (x / float(fb.w)) * playerFov; // current ray angle
+    /**
+     * @brief Casts the ray of a screen column with Digital Differential Analysis (DDA).
+     * 
+     * With a draw distance, the ray stops at the first cell boundary beyond it and the column
+     * shows a slice of fog at the draw distance (wall_id -1) instead of a wall.
+     * 
+     * The cells crossed by the ray, the wall included, are marked in the visible cells of the
+     * framebuffer, and the hit is saved in its ray hits.
+     * 
+     * @param x The column.
+     * @return The wall hit by the ray.
+     */
+    WallHit cast(const size_t x) const {
+        float ray_angle = (playerViewDir - playerFov / 2) + (x / float(w)) * playerFov; // current ray angle
 
         // calculate the direction of the ray
         float ray_dir_x = cos(ray_angle);
@@ -306,8 +751,22 @@ void render(FrameBuffer &fb, const GameState &gs, SDL_Renderer* renderer) {
             side_dist_y = (map_y + 1.0 - posY) * delta_dist_y;
         }
 
+        const float max_dist = settings.draw_distance > 0 ? settings.draw_distance : INFINITY;
+        CellMarker cells{ visible_cells, gs.map.w, SIZE_MAX, 0 };
+        if (visible_cells) cells.mark(map_x, map_y);
+
         // perform Digital Differential Analysis (DDA)
         while (!hit) {
+            if (std::min(side_dist_x, side_dist_y) > max_dist) { // the next wall could only be beyond the draw distance
+                const int line_height = (int)(h / max_dist);
+                const int draw_start = std::max(0, -line_height / 2 + int(h / 2));
+                const int draw_end = std::min(int(h) - 1, line_height / 2 + int(h / 2));
+                cells.flush();
+                if (ray_hits)
+                    ray_hits[x] = RayHit{ map_x, map_y, -1, posX + ray_dir_x * max_dist, posY + ray_dir_y * max_dist,
+                                          max_dist, max_dist * std::cos(ray_angle - playerViewDir), -1, 0 };
+                return WallHit{ max_dist, draw_start, draw_end, line_height, 0, -1, LABEL_FOG };
+            }
             if (side_dist_x < side_dist_y) { 
                 side_dist_x += delta_dist_x;
                 map_x += step_x;
@@ -318,51 +777,367 @@ void render(FrameBuffer &fb, const GameState &gs, SDL_Renderer* renderer) {
                 side = 1;
             }
 
+            if (visible_cells) cells.mark(map_x, map_y);
+
             // check if the ray has hit a wall
             int map_value = gs.map.get(map_x, map_y);        
             if (map_value > 0 && map_value != 9) hit = true; // 9 is where the player stay to open the door
         }
+        cells.flush();
 
         // calculate distance projected on camera direction (Euclidean distance will give fisheye effect!)
         if (side == 0) 
             perp_wall_dist = (map_x - posX + (1 - step_x) / 2) / ray_dir_x;
         else
             perp_wall_dist = (map_y - posY + (1 - step_y) / 2) / ray_dir_y;
-        
-        depth_buffer[x] = perp_wall_dist; // save the distance for the current column
 
-        int line_height = (int)(fb.h / perp_wall_dist); // height of the line to draw on the screen
+        int line_height = (int)(h / perp_wall_dist); // height of the line to draw on the screen
 
-        int draw_start = -line_height / 2 + fb.h / 2;
+        int draw_start = -line_height / 2 + h / 2;
         if (draw_start < 0) draw_start = 0;     
-        int draw_end = line_height / 2 + fb.h / 2;
-        if (draw_end >= fb.h) draw_end = fb.h - 1;
+        int draw_end = line_height / 2 + h / 2;
+        if (draw_end >= int(h)) draw_end = h - 1;
 
         // calculate value of wall_x
-        int tex_x = wall_x_texcoord(posX + ray_dir_x * perp_wall_dist, posY + ray_dir_y * perp_wall_dist, gs.tex_walls);
-
-        // draw the wall slice
-        for (int y = draw_start; y < draw_end; y++) {
-            int d = y * 256 - fb.h * 128 + line_height * 128;
-            int tex_y = ((d * gs.tex_walls.size) / line_height) / 256;
-            uint32_t color = gs.tex_walls.get(tex_x, tex_y, gs.map.get(map_x, map_y));
-            fb.set_pixel(x, y, color);
+        const float hit_x = posX + ray_dir_x * perp_wall_dist, hit_y = posY + ray_dir_y * perp_wall_dist;
+        int tex_x = wall_x_texcoord(hit_x, hit_y, tex_walls);
+
+        const int wall_id = gs.map.get(map_x, map_y);
+        if (ray_hits)
+            ray_hits[x] = RayHit{ map_x, map_y, side, hit_x, hit_y, perp_wall_dist, perp_wall_dist * std::cos(ray_angle - playerViewDir), wall_id, tex_x };
+        const uint16_t wall_label = wall_id == 3 ? LABEL_DOOR : LABEL_WALL + wall_id;
+        return WallHit{ perp_wall_dist, draw_start, draw_end, line_height, tex_x, wall_id, wall_label };
+    }
+
+    /**
+     * @brief Draws the rows [y0, y1) of the wall slice of a column.
+     * 
+     * The texture row of the screen row y is (y*256 - h*128 + line_height*128) * size / (line_height*256),
+     * whatever the first row drawn.
+     */
+    void draw_wall(const size_t x, const WallHit &hit, const int y0, const int y1) const {
+        const int start = std::max(hit.draw_start, y0);
+        const int end = std::min(hit.draw_end, y1);
+        if (start >= end) return;
+        if (hit.wall_id < 0) { // fog
+            draw_column<RGBA32, Blend::OPAQUE, Shade::NONE>(aux, fb, x, start, end, &settings.fog_color, 0, TexStepper(0, 0, 1), hit.dist, hit.label);
+            return;
         }
+        const int64_t d = std::max<int64_t>(0, int64_t(hit.draw_start) * 256 - int64_t(h) * 128 + int64_t(hit.line_height) * 128)
+                        + int64_t(start - hit.draw_start) * 256;
+        TexStepper v(d * size, 256 * size, 256 * int64_t(hit.line_height));
+        const FogBlend fog{ settings.fog_color, settings.fog_weight(hit.dist) };
+        if (fog.weight)
+            draw_column<RGBA32, Blend::OPAQUE, Shade::FOG>(aux, fb, x, start, end, tex_walls.column(hit.tex_x, hit.wall_id), stride, v, hit.dist, hit.label, 0, nullptr, fog);
+        else
+            draw_column<RGBA32, Blend::OPAQUE, Shade::NONE>(aux, fb, x, start, end, tex_walls.column(hit.tex_x, hit.wall_id), stride, v, hit.dist, hit.label);
     }
+};
+
+/**
+ * @brief Draws the 3D view: the floor and the ceiling, then the walls with ray casting.
+ * 
+ * @tparam TexSize The size of the wall textures, or 0 (see ViewCaster).
+ * @tparam W The width of the framebuffer, or 0.
+ * @tparam H The height of the framebuffer, or 0.
+ * @param fb The framebuffer to draw into.
+ * @param gs The game state to draw.
+ * @param settings The settings of the frame.
+ * @param depth_buffer Receives the distance of the wall drawn in each column, fb.w values.
+ * @param pool The pool drawing bands of rows and columns in parallel, nullptr to draw on the calling thread.
+ */
+template <size_t TexSize, size_t W, size_t H>
+static void draw_view(FrameBuffer &fb, const GameState &gs, const RenderSettings &settings, float *depth_buffer, ThreadPool *pool) {
+    const ViewCaster<TexSize, W, H> view(fb, gs, settings);
+
+    // -------------- 3D engine --------------
+    // Draw the floor and ceiling
+    auto draw_floor_rows = [&](const size_t begin, const size_t end) {
+        view.draw_floor(begin, end, 0, view.w, view.row_x + begin, view.row_y + begin);
+    };
+    if (pool) { // bands of rows in parallel, in multiples of the widest kernel so that it draws all of them
+        const size_t band = std::max<size_t>(16, (view.rows_count / (pool->size() * 4) + 15) / 16 * 16);
+        pool->parallel_for_range(view.rows_count, band, draw_floor_rows);
+    }
+    else draw_floor_rows(0, view.rows_count);
+
+    // Draw the walls - Ray casting with DDA, in bands of columns when there is a pool
+    auto draw_walls = [&](const size_t begin, const size_t end) {
+        for (size_t x = begin; x < end; x++) {
+            const WallHit hit = view.cast(x);
+            depth_buffer[x] = hit.dist; // save the distance for the current column
+            view.draw_wall(x, hit, 0, view.h);
+        }
+    };
+    if (pool) pool->parallel_for_range(view.w, 0, draw_walls);
+    else draw_walls(0, view.w);
     // --------------------------------------
+}
+
+/**
+ * @brief Draws the 3D view and the sprites tile by tile.
+ * 
+ * The rays of all the columns are cast first, and the sprites showing in every column listed. Then the screen is cut into tiles of TILE columns
+ * and two symmetrical bands of TILE rows (a band of floor rows and the band of the ceiling rows
+ * showing the same texels), and every tile draws its floor and ceiling, its part of the walls
+ * and the sprites showing in it (see draw_sprite_column). The tiles are jobs of the
+ * pool: the threads done with their tiles steal the others, so a side of the screen busier than
+ * the other (a close-up sprite, walls taller than the screen) does not hold the frame back, and
+ * the pixels of a tile are drawn over each other while they are in the cache.
+ * 
+ * The floor positions seen by the first column of each tile are accumulated by the same float
+ * additions as a whole row, so the pixels are those of draw_view() and draw_sprites().
+ * 
+ * @tparam TexSize The size of the wall textures, or 0 (see ViewCaster).
+ * @tparam W The width of the framebuffer, or 0.
+ * @tparam H The height of the framebuffer, or 0.
+ * @param fb The framebuffer to draw into.
+ * @param gs The game state to draw.
+ * @param settings The settings of the frame.
+ * @param depth_buffer Receives the distance of the wall drawn in each column, fb.w values.
+ * @param pool The pool drawing the tiles in parallel, nullptr to draw on the calling thread.
+ */
+template <size_t TexSize, size_t W, size_t H>
+static void draw_view_tiled(FrameBuffer &fb, const GameState &gs, const RenderSettings &settings, float *depth_buffer, ThreadPool *pool) {
+    const ViewCaster<TexSize, W, H> view(fb, gs, settings);
+    const size_t w = view.w, h = view.h, half = view.half, rows_count = view.rows_count;
+    const size_t tiles_x = (w + TILE - 1) / TILE;
+    const size_t bands = (rows_count + TILE - 1) / TILE;
+
+    FrameArena &arena = FrameArena::local();
+    WallHit *hits = arena.alloc<WallHit>(w);
+    float *tile_x = arena.alloc<float>(tiles_x * rows_count); // position seen by the first column of each tile, for each row: [tile][row]
+    float *tile_y = arena.alloc<float>(tiles_x * rows_count);
+    uint8_t *covered = arena.alloc<uint8_t>(tiles_x * h); // flags of the rows of the sprites, for each column of tiles
+
+    auto cast_columns = [&](const size_t begin, const size_t end) {
+        for (size_t x = begin; x < end; x++) {
+            hits[x] = view.cast(x);
+            depth_buffer[x] = hits[x].dist;
+        }
+    };
+    SpriteSpans spans;
+    auto start_rows = [&](const size_t begin, const size_t end) {
+        for (size_t r0 = begin; r0 < end; r0 += 16) { // 16 rows at a time in local arrays, so that the additions are vectorized
+            const size_t n = std::min<size_t>(16, end - r0);
+            float fx[16] = {}, fy[16] = {}, sx[16] = {}, sy[16] = {};
+            std::copy(view.row_x + r0, view.row_x + r0 + n, fx);
+            std::copy(view.row_y + r0, view.row_y + r0 + n, fy);
+            std::copy(view.row_step_x + r0, view.row_step_x + r0 + n, sx);
+            std::copy(view.row_step_y + r0, view.row_step_y + r0 + n, sy);
+            for (size_t t = 0; t < tiles_x; t++) {
+                std::copy(fx, fx + n, tile_x + t * rows_count + r0);
+                std::copy(fy, fy + n, tile_y + t * rows_count + r0);
+                for (size_t k = 0; k < TILE; k++) {
+                    for (size_t l = 0; l < 16; l++) {
+                        fx[l] += sx[l];
+                        fy[l] += sy[l];
+                    }
+                }
+            }
+        }
+    };
+    auto draw_tiles = [&](const size_t begin, const size_t end) {
+        for (size_t tile = begin; tile < end; tile++) {
+            const size_t t = tile % tiles_x, band = tile / tiles_x;
+            const size_t x0 = t * TILE, x1 = std::min(w, x0 + TILE);
+            const size_t r0 = band * TILE, r1 = std::min(rows_count, r0 + TILE);
+            view.draw_floor(r0, r1, x0, x1, tile_x + t * rows_count + r0, tile_y + t * rows_count + r0);
+
+            // the floor rows, and the ceiling rows but the middle one of odd heights, already in the floor rows
+            const int rows[2][2] = { { int(h - half - r1), int(std::min(h - half - r0, half)) }, { int(half + r0), int(half + r1) } };
+            for (const auto &y : rows) {
+                for (size_t x = x0; x < x1; x++)
+                    view.draw_wall(x, hits[x], y[0], y[1]);
+                for (size_t x = x0; x < x1; x++)
+                    draw_sprite_column(fb, spans, x, y[0], y[1], covered + t * h);
+            }
+        }
+    };
+
+    if (pool) {
+        pool->parallel_for_range(w, 0, cast_columns);
+        pool->parallel_for_range(rows_count, 0, start_rows);
+        spans = list_sprite_spans(fb, gs, depth_buffer, settings);
+        pool->parallel_for_range(tiles_x * bands, 1, draw_tiles);
+    } else {
+        cast_columns(0, w);
+        start_rows(0, rows_count);
+        spans = list_sprite_spans(fb, gs, depth_buffer, settings);
+        draw_tiles(0, tiles_x * bands);
+    }
+    release_sprite_images(spans);
+}
+
+// Draws the 3D view with the instance of draw_view (or draw_view_tiled) specialized for the configuration
+using ViewRenderer = void (*)(FrameBuffer&, const GameState&, const RenderSettings&, float*, ThreadPool*);
+
+template <size_t TexSize, size_t W, size_t H>
+static ViewRenderer view_renderer(const bool tiled) {
+    return tiled ? draw_view_tiled<TexSize, W, H> : draw_view<TexSize, W, H>;
+}
+
+template <size_t TexSize>
+static ViewRenderer select_resolution(const size_t w, const size_t h, const bool tiled) {
+    if (w == 320 && h == 200) return view_renderer<TexSize, 320, 200>(tiled);
+    if (w == 640 && h == 400) return view_renderer<TexSize, 640, 400>(tiled);
+    if (w == 1200 && h == 600) return view_renderer<TexSize, 1200, 600>(tiled); // the window
+    if (w == 1920 && h == 1080) return view_renderer<TexSize, 1920, 1080>(tiled);
+    return view_renderer<TexSize, 0, 0>(tiled);
+}
+
+/**
+ * @brief Picks the instance of draw_view or draw_view_tiled for the given wall texture size and resolution.
+ * 
+ * Textures of 64 and 128 pixels and the common resolutions have specialized instances,
+ * any other configuration falls back to the generic one.
+ * 
+ * @param tex_size The size of the wall textures.
+ * @param w The width of the framebuffer.
+ * @param h The height of the framebuffer.
+ * @param tiled Whether to draw tile by tile, with the sprites.
+ * @return The function drawing the 3D view.
+ */
+static ViewRenderer select_view(const size_t tex_size, const size_t w, const size_t h, const bool tiled) {
+    if (tex_size == 64) return select_resolution<64>(w, h, tiled);
+    if (tex_size == 128) return select_resolution<128>(w, h, tiled);
+    return view_renderer<0, 0, 0>(tiled);
+}
+
+// ----------------------------- passes of a frame, see standard_frame_graph() -----------------------------
+
+static void pass_clear(RenderFrame &frame) {
+    frame.fb.clear(pack_color(255, 255, 255)); // clear the screen
+}
 
-    // Draw the sprites
-    for (const auto &sprite : gs.monsters) {
-        draw_sprite(sprite, gs.player, fb, depth_buffer, gs.tex_monst);
+static void pass_view(RenderFrame &frame) {
+    select_view(frame.gs.tex_walls->size, frame.fb.w, frame.fb.h, false)(frame.fb, frame.gs, frame.settings, frame.depth_buffer, frame.pool); // floor, ceiling and walls
+}
+
+static void pass_tiles(RenderFrame &frame) {
+    select_view(frame.gs.tex_walls->size, frame.fb.w, frame.fb.h, true)(frame.fb, frame.gs, frame.settings, frame.depth_buffer, frame.pool); // floor, ceiling, walls and sprites
+}
+
+static void pass_minimap(RenderFrame &frame) {
+    draw_map(frame.minimap, frame.minimap_w, frame.minimap_h, frame.gs.monsters, *frame.gs.tex_walls, frame.gs.map, frame.gs.player, frame.cell_w, frame.cell_h);
+}
+
+static void pass_sprites(RenderFrame &frame) {
+    draw_sprites(frame.fb, frame.gs, frame.depth_buffer, frame.settings, frame.pool);
+}
+
+// Copies the minimap layer over the 3D view, the whole area is HUD
+static void pass_minimap_composite(RenderFrame &frame) {
+    FrameBuffer &fb = frame.fb;
+    for (size_t y = 0; y < frame.minimap_h; y++) {
+        const uint32_t *row = frame.minimap + y * frame.minimap_w;
+        std::copy(row, row + frame.minimap_w, fb.img.begin() + (frame.minimap_y + y) * fb.w + frame.minimap_x);
+        if (!fb.has_aux()) continue;
+        for (size_t x = 0; x < frame.minimap_w; x++)
+            fb.set_aux(frame.minimap_x + x, frame.minimap_y + y, 0, LABEL_HUD);
     }
+}
+
+static void pass_gun(RenderFrame &frame) {
+    draw_gun(frame.fb, *frame.gs.tex_gun, frame.gs.player.shooting);
+}
+
+/**
+ * @brief Builds the graph of the passes drawn by render().
+ *
+ * - clear: clears the screen, skipped since the view covers it.
+ * - view: the floor and ceiling using ray casting, and the walls using Digital Differential Analysis (DDA).
+ * - minimap: the map, player and sprites drawn into their own layer, at the same time as the view.
+ * - sprites: the monsters, tested against the depth of the walls.
+ * - minimap_composite: the minimap layer copied on top of the 3D view.
+ * - gun: the player's gun.
+ *
+ * Passes can be disabled with FrameGraph::set_enabled, e.g. the HUD for agent observations.
+ * TODO: a pass checking if the player is near a door and showing "F to open".
+ *
+ * @return The graph.
+ */
+FrameGraph standard_frame_graph() {
+    FrameGraph graph;
+    graph.add("clear",             0,           RES_FRAME,             RES_FRAME,             pass_clear);
+    graph.add("view",              0,           RES_FRAME | RES_DEPTH, RES_FRAME | RES_DEPTH, pass_view);
+    graph.add("minimap",           0,           RES_MINIMAP,           RES_MINIMAP,           pass_minimap);
+    graph.add("sprites",           RES_DEPTH,   RES_FRAME,             0,                     pass_sprites);
+    graph.add("minimap_composite", RES_MINIMAP, RES_FRAME,             0,                     pass_minimap_composite);
+    graph.add("gun",               0,           RES_FRAME,             0,                     pass_gun);
+    return graph;
+}
+
+/**
+ * @brief Builds the graph drawing the 3D view and the sprites tile by tile (see draw_view_tiled).
+ *
+ * The passes are those of standard_frame_graph(), but view and sprites are replaced by a single
+ * tiles pass. The pixels are the same, the work is balanced better between the threads of the pool.
+ *
+ * @return The graph.
+ */
+FrameGraph tiled_frame_graph() {
+    FrameGraph graph;
+    graph.add("clear",             0,           RES_FRAME,             RES_FRAME,             pass_clear);
+    graph.add("tiles",             0,           RES_FRAME | RES_DEPTH, RES_FRAME | RES_DEPTH, pass_tiles);
+    graph.add("minimap",           0,           RES_MINIMAP,           RES_MINIMAP,           pass_minimap);
+    graph.add("minimap_composite", RES_MINIMAP, RES_FRAME,             0,                     pass_minimap_composite);
+    graph.add("gun",               0,           RES_FRAME,             0,                     pass_gun);
+    return graph;
+}
 
-    // Draw the map on top of the 3D view
-    draw_map(fb, gs.monsters, gs.tex_walls, gs.map, gs.player, cell_w, cell_h);
+/**
+ * @brief Renders the game frame.
+ * 
+ * This function is responsible for rendering the entire game frame, including the floor, ceiling, walls, sprites, and HUD elements,
+ * with the passes of standard_frame_graph().
+ * 
+ * @param fb The framebuffer to render to.
+ * @param gs The current game state, containing player information, textures, and map data.
+ * @param renderer The SDL renderer used for rendering.
+ * @param pool The pool running the passes and the loops of the 3D view in parallel, nullptr to draw on the calling thread.
+ */
+void render(FrameBuffer &fb, const GameState &gs, SDL_Renderer* renderer, ThreadPool *pool) {
+    static const FrameGraph graph = standard_frame_graph();
+    render(fb, gs, graph, pool);
+}
 
-    // Show gun on the screen
-    draw_gun(fb, tex_gun, gs.player.shooting);
+/**
+ * @brief Renders the game frame with the given passes.
+ * 
+ * The temporaries (e.g. the depth buffer of the columns and the minimap layer) live in the
+ * FrameArena of the calling thread and are released when the frame is done.
+ * 
+ * When the framebuffer has depth and label buffers (see FrameBuffer::enable_aux), every pass
+ * also writes the distance and the SemanticLabel of the pixels it draws. When it keeps the
+ * visible cells (see FrameBuffer::enable_visible_cells), they are those of this frame.
+ * 
+ * @param fb The framebuffer to render to.
+ * @param gs The current game state, containing player information, textures, and map data.
+ * @param graph The passes to draw.
+ * @param pool The pool running the passes and the loops of the 3D view in parallel, nullptr to draw on the calling thread.
+ * @param settings The options of the frame (sprite level of detail...).
+ */
+void render(FrameBuffer &fb, const GameState &gs, const FrameGraph &graph, ThreadPool *pool, const RenderSettings &settings) {
+    // the passes write the pixels in place, and clear (the only one sizing the storage) is usually skipped
+    if (fb.img.size() != fb.w * fb.h) fb.img.resize(fb.w * fb.h, pack_color(255, 255, 255));
+
+    AllocScope scope(ALLOC_RENDER);
 
-    // Check if the player is near a door and show "F to open" - TODO: Fix this
-    size_t i = static_cast<size_t>(posX);
-    size_t j = static_cast<size_t>(posY);
-}
\ No newline at end of file
+    FrameArena &arena = FrameArena::local(); // scratch memory of this frame, so that a frame does not allocate
+    ArenaScope frame_memory(arena);
+
+    // size of one map cell on the screen
+    const size_t cell_w = fb.w / (gs.map.w * 4);
+    const size_t cell_h = fb.h / (gs.map.h * 4);
+    const size_t minimap_w = gs.map.w * cell_w;
+    const size_t minimap_h = gs.map.h * cell_h;
+
+    RenderFrame frame{ fb, gs, settings, pool,
+                       arena.alloc<float>(fb.w, 1e3f), // buffer to store the Z-coordinate based on the ray casting
+                       arena.alloc<uint32_t>(minimap_w * minimap_h),
+                       fb.w - minimap_w, fb.h - minimap_h, minimap_w, minimap_h,
+                       cell_w, cell_h };
+    std::fill(fb.visible_cells.begin(), fb.visible_cells.end(), 0);
+    graph.execute(frame, pool);
+}
@@ -0,0 +1,201 @@
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef int socklen_t;
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "../include/headers/transport.h"
+
+static constexpr size_t max_datagram = 65507;
+
+/**
+ * @brief Opens a non-blocking UDP socket bound to the given port on every interface.
+ * 
+ * @param port The local port, 0 to let the system pick a free one.
+ * @param peers The known peers, numbered in the order of the list.
+ */
+UdpTransport::UdpTransport(const uint16_t port, const std::vector<Endpoint> &peers) : sock(-1), bound_port(0) {
+#ifdef _WIN32
+    static bool wsa_ready = [] { WSADATA data; return WSAStartup(MAKEWORD(2, 2), &data) == 0; }();
+    if (!wsa_ready) return;
+#endif
+    for (const Endpoint &peer : peers) {
+        in_addr address;
+        if (inet_pton(AF_INET, peer.host.c_str(), &address) != 1) {
+            std::cerr << "Invalid peer address: " << peer.host << std::endl;
+            return;
+        }
+        addresses.emplace_back(address.s_addr, htons(peer.port));
+    }
+
+    int s = static_cast<int>(socket(AF_INET, SOCK_DGRAM, 0));
+    if (s < 0) {
+        std::cerr << "Failed to create UDP socket" << std::endl;
+        return;
+    }
+
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(port);
+    if (bind(s, reinterpret_cast<sockaddr *>(&local), sizeof(local)) < 0) {
+        std::cerr << "Failed to bind UDP port " << port << std::endl;
+#ifdef _WIN32
+        closesocket(s);
+#else
+        close(s);
+#endif
+        return;
+    }
+
+    int buffer_size = 4 << 20; // servers receive bursts from many clients at once
+    setsockopt(s, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char *>(&buffer_size), sizeof(buffer_size));
+    setsockopt(s, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char *>(&buffer_size), sizeof(buffer_size));
+
+#ifdef _WIN32
+    u_long non_blocking = 1;
+    ioctlsocket(s, FIONBIO, &non_blocking);
+#else
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+    socklen_t length = sizeof(local);
+    getsockname(s, reinterpret_cast<sockaddr *>(&local), &length);
+    bound_port = ntohs(local.sin_port);
+    sock = s;
+}
+
+UdpTransport::~UdpTransport() {
+    if (sock < 0) return;
+#ifdef _WIN32
+    closesocket(static_cast<SOCKET>(sock));
+#else
+    close(static_cast<int>(sock));
+#endif
+}
+
+bool UdpTransport::ok() const {
+    return sock >= 0;
+}
+
+uint16_t UdpTransport::port() const {
+    return bound_port;
+}
+
+size_t UdpTransport::peers() const {
+    return addresses.size();
+}
+
+void UdpTransport::send(const size_t peer, const uint8_t *data, const size_t size) {
+    assert(peer < addresses.size() && size <= max_datagram);
+    if (sock < 0) return;
+    sockaddr_in remote{};
+    remote.sin_family = AF_INET;
+    remote.sin_addr.s_addr = addresses[peer].first;
+    remote.sin_port = addresses[peer].second;
+    sendto(static_cast<int>(sock), reinterpret_cast<const char *>(data), static_cast<int>(size), 0, reinterpret_cast<sockaddr *>(&remote), sizeof(remote));
+}
+
+/**
+ * @brief Reads one waiting datagram, if any.
+ * 
+ * The sender is looked up among the known peers; an unknown sender becomes a new peer.
+ * 
+ * @param peer Set to the index of the sender.
+ * @param packet Set to the payload; its storage is reused from one call to the next.
+ * @return false if no datagram is waiting.
+ */
+bool UdpTransport::receive(size_t &peer, std::vector<uint8_t> &packet) {
+    if (sock < 0) return false;
+    packet.resize(max_datagram);
+    sockaddr_in remote{};
+    socklen_t length = sizeof(remote);
+    int n = static_cast<int>(recvfrom(static_cast<int>(sock), reinterpret_cast<char *>(packet.data()), static_cast<int>(packet.size()), 0, reinterpret_cast<sockaddr *>(&remote), &length));
+    if (n < 0) {
+        packet.clear();
+        return false;
+    }
+    packet.resize(n);
+
+    auto source = std::make_pair(static_cast<uint32_t>(remote.sin_addr.s_addr), remote.sin_port);
+    for (peer = 0; peer < addresses.size() && addresses[peer] != source; peer++);
+    if (peer == addresses.size()) addresses.push_back(source);
+    return true;
+}
+
+LoopbackHub::LoopbackHub(const size_t peers) : ports(peers), queues(peers) {
+    for (size_t i = 0; i < peers; i++) {
+        ports[i].hub = this;
+        ports[i].self = i;
+    }
+}
+
+Transport &LoopbackHub::endpoint(const size_t peer) {
+    assert(peer < ports.size());
+    return ports[peer];
+}
+
+void LoopbackHub::Port::send(const size_t peer, const uint8_t *data, const size_t size) {
+    std::lock_guard<std::mutex> lock(hub->mutex);
+    assert(peer < hub->queues.size());
+    hub->queues[peer].emplace_back(self, std::vector<uint8_t>(data, data + size));
+}
+
+bool LoopbackHub::Port::receive(size_t &peer, std::vector<uint8_t> &packet) {
+    std::lock_guard<std::mutex> lock(hub->mutex);
+    auto &queue = hub->queues[self];
+    if (queue.empty()) return false;
+    peer = queue.front().first;
+    packet.swap(queue.front().second);
+    queue.pop_front();
+    return true;
+}
+
+/**
+ * @brief Wraps a transport to degrade it like a bad network link.
+ * 
+ * @param inner The transport actually carrying the packets.
+ * @param latency_ms The one-way delay added to every packet.
+ * @param jitter_ms The maximum random delay added on top of the latency (packets can be reordered).
+ * @param loss The probability of dropping a packet, between 0 and 1.
+ * @param seed The seed of the random generator, for reproducible runs.
+ */
+LossyTransport::LossyTransport(Transport &inner, const double latency_ms, const double jitter_ms, const double loss, const uint32_t seed) :
+    inner(inner), latency_ms(latency_ms), jitter_ms(jitter_ms), loss(loss), rng(seed) {}
+
+void LossyTransport::flush() {
+    const auto now = std::chrono::steady_clock::now();
+    for (auto it = delayed.begin(); it != delayed.end(); ) {
+        if (it->due <= now) {
+            inner.send(it->peer, it->data.data(), it->data.size());
+            it = delayed.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void LossyTransport::send(const size_t peer, const uint8_t *data, const size_t size) {
+    std::uniform_real_distribution<double> uniform(0., 1.);
+    if (uniform(rng) >= loss) {
+        const double delay = latency_ms + jitter_ms * uniform(rng);
+        const auto due = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(delay));
+        delayed.push_back(Delayed{due, peer, std::vector<uint8_t>(data, data + size)});
+    }
+    flush();
+}
+
+bool LossyTransport::receive(size_t &peer, std::vector<uint8_t> &packet) {
+    flush();
+    return inner.receive(peer, packet);
+}
@@ -0,0 +1,128 @@
+#include <iostream>
+#include <vector>
+#include <map>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <memory>
+
+#include "../include/headers/netcode.h"
+#include "../include/headers/transport.h"
+#include "../include/headers/snapshot.h"
+
+/**
+ * @file rollback.cpp
+ * @brief Checks that two rollback peers converge over a bad network.
+ *
+ * Usage: RollbackCheck [ticks]
+ *
+ * Two RollbackSession play random inputs over LossyTransport (latency, jitter and loss), first
+ * through a LoopbackHub, then through UDP sockets on 127.0.0.1. Every state a peer confirms must
+ * be the state simulated here from the inputs of both players, and the consistency reports must
+ * find no desync.
+ * Returns 0 on success.
+ */
+
+static uint64_t hash_bytes(const uint8_t *data, const size_t size) {
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < size; i++) {
+        h ^= data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static uint64_t hash_state(Snapshot &snapshot, const NetState &state) {
+    snapshot.save(state.world, state.players);
+    return hash_bytes(snapshot.data(), snapshot.size());
+}
+
+/**
+ * @brief Plays a session between two peers and compares their confirmed states with a reference.
+ *
+ * @param name The name of the network, for the report.
+ * @param a The transport of the player 0, its peer 1 being the other player.
+ * @param b The transport of the player 1, its peer 0 being the other player.
+ * @param ticks The number of ticks played with random inputs.
+ * @return true if the peers converged without desync.
+ */
+static bool play(const char *name, Transport &a, Transport &b, const uint32_t ticks) {
+    const GameState initial = new_game("");
+    LossyTransport lossy_a(a, 20, 15, 0.1, 1), lossy_b(b, 20, 15, 0.1, 2);
+    RollbackConfig config;
+    config.sync_interval = 20;
+    RollbackSession peers[2] = { RollbackSession(initial, 2, 0, lossy_a), RollbackSession(initial, 2, 1, lossy_b) };
+
+    std::mt19937 rng(7);
+    std::vector<uint8_t> inputs[2];            // inputs of each player, per tick
+    std::map<uint32_t, uint64_t> confirmed[2]; // hash of the confirmed state of each peer, per tick
+    Snapshot snapshot;
+    for (size_t p = 0; p < 2; p++) inputs[p].assign(config.input_delay, encode_action(Action{ 0, 0, false, false }));
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    while (std::min(peers[0].confirmed_tick(), peers[1].confirmed_tick()) < ticks) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            std::cerr << name << ": the peers stopped confirming ticks at " << peers[0].confirmed_tick() << " and " << peers[1].confirmed_tick() << std::endl;
+            return false;
+        }
+        for (size_t p = 0; p < 2; p++) {
+            RollbackSession &peer = peers[p];
+            Action input{ 0, 0, false, false }; // idle once the random inputs are played, until the last ones are confirmed
+            if (peer.tick() < ticks) input = Action{ int(rng() % 3) - 1, int(rng() % 3) - 1, rng() % 30 == 0, rng() % 10 == 0 };
+            if (peer.advance(input)) inputs[p].push_back(encode_action(input)); // scheduled at tick() - 1 + input_delay
+            peer.save_confirmed(snapshot);
+            confirmed[p][peer.confirmed_tick()] = hash_bytes(snapshot.data(), snapshot.size());
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    // replay the inputs of both players without any network
+    NetState reference{ initial, std::vector<Player>(2, initial.player) };
+    size_t compared = 0, different = 0;
+    for (uint32_t t = 0; t <= ticks; t++) {
+        const uint64_t expected = hash_state(snapshot, reference);
+        for (size_t p = 0; p < 2; p++) {
+            auto state = confirmed[p].find(t);
+            if (state == confirmed[p].end()) continue;
+            compared++;
+            if (state->second != expected) different++;
+        }
+        const Action actions[2] = { decode_action(inputs[0][t]), decode_action(inputs[1][t]) };
+        simulate(reference, actions);
+    }
+    std::cout << name << ": " << compared << " confirmed states compared, " << different << " different, desyncs " << peers[0].desyncs() << " and " << peers[1].desyncs()
+              << ", rollbacks " << peers[0].rollbacks() << " and " << peers[1].rollbacks() << std::endl;
+    return compared > 0 && !different && !peers[0].desyncs() && !peers[1].desyncs();
+}
+
+int main(int argc, char **argv) {
+    const uint32_t ticks = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 600;
+    bool ok = true;
+
+    LoopbackHub hub(2);
+    ok = play("loopback", hub.endpoint(0), hub.endpoint(1), ticks) && ok;
+
+    // the peers of a UdpTransport are numbered as the players: the player 0 learns the address
+    // of the player 1 from a first datagram, received before the session starts
+    UdpTransport udp_a(0, { {"127.0.0.1", 0} }); // peer 0 is itself, never sent to
+    if (!udp_a.ok()) {
+        std::cerr << "Cannot open a UDP socket" << std::endl;
+        return -1;
+    }
+    UdpTransport udp_b(0, { {"127.0.0.1", udp_a.port()} });
+    const uint8_t hello = 0xFF;
+    size_t sender;
+    std::vector<uint8_t> packet;
+    do {
+        udp_b.send(0, &hello, 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    } while (!udp_a.receive(sender, packet));
+    while (udp_a.receive(sender, packet)); // drop the extra hellos
+    if (sender != 1 || udp_a.peers() != 2) {
+        std::cerr << "Unexpected UDP peer " << sender << std::endl;
+        return -1;
+    }
+    ok = play("udp", udp_a, udp_b, ticks) && ok;
+
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}